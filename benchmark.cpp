@@ -0,0 +1,338 @@
+// Benchmarks of the search server on generated corpora.
+// Build it like main.cpp, in place of it:
+//     g++ -std=c++17 -O2 -Iinclude benchmark.cpp include/*.cpp -ltbb -lpthread -o benchmark
+// Options are --name=value, see Config. Results go to stdout as JSON, a summary to stderr.
+
+#include "corpus_generator.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <execution>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct Config {
+    int seed = 42;
+    int document_count = 10'000;
+    int dictionary_size = 1'000;
+    int max_word_length = 10;
+    int document_word_count = 70;
+    // Share of documents that are shuffled copies of earlier ones, found by RemoveDuplicates
+    double duplicate_share = 0.01;
+    int query_count = 1'000;
+    int query_word_count = 10;
+    double minus_word_prob = 0.1;
+    // Skew of word frequencies in documents and queries, 0 is uniform
+    double zipf_exponent = 1.0;
+    int warmup = 1;
+    int repetitions = 3;
+    // Benchmarks whose name contains this, all by default
+    string filter;
+};
+
+Config ParseConfig(int argc, char* argv[]) {
+    Config config;
+    map<string, function<void(const string&)>> options = {
+        { "seed", [&config](const string& value) { config.seed = stoi(value); } },
+        { "documents", [&config](const string& value) { config.document_count = stoi(value); } },
+        { "dictionary", [&config](const string& value) { config.dictionary_size = stoi(value); } },
+        { "max-word-length", [&config](const string& value) { config.max_word_length = stoi(value); } },
+        { "document-words", [&config](const string& value) { config.document_word_count = stoi(value); } },
+        { "duplicates", [&config](const string& value) { config.duplicate_share = stod(value); } },
+        { "queries", [&config](const string& value) { config.query_count = stoi(value); } },
+        { "query-words", [&config](const string& value) { config.query_word_count = stoi(value); } },
+        { "minus-prob", [&config](const string& value) { config.minus_word_prob = stod(value); } },
+        { "zipf", [&config](const string& value) { config.zipf_exponent = stod(value); } },
+        { "warmup", [&config](const string& value) { config.warmup = stoi(value); } },
+        { "repetitions", [&config](const string& value) { config.repetitions = stoi(value); } },
+        { "filter", [&config](const string& value) { config.filter = value; } },
+    };
+    for (int i = 1; i < argc; ++i) {
+        const string_view argument = argv[i];
+        const size_t equals = argument.find('=');
+        if (argument.substr(0, 2) != "--"sv || equals == argument.npos) {
+            throw invalid_argument("expected --name=value, got "s + string(argument));
+        }
+        const auto option = options.find(string(argument.substr(2, equals - 2)));
+        if (option == options.end()) {
+            throw invalid_argument("unknown option "s + string(argument));
+        }
+        option->second(string(argument.substr(equals + 1)));
+    }
+    if (config.document_count <= 0 || config.dictionary_size <= 0 || config.query_count <= 0 || config.repetitions <= 0) {
+        throw invalid_argument("counts must be positive"s);
+    }
+    return config;
+}
+
+// Durations of single operations or of whole batches, in nanoseconds
+class Samples {
+public:
+    template <typename Operation>
+    void Time(Operation operation) {
+        const auto start = chrono::steady_clock::now();
+        operation();
+        const auto duration = chrono::steady_clock::now() - start;
+        if (is_recording_) {
+            durations_.push_back(static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(duration).count()));
+        }
+    }
+
+    void SetRecording(bool is_recording) {
+        is_recording_ = is_recording;
+    }
+
+    vector<double>& GetDurations() {
+        return durations_;
+    }
+
+private:
+    vector<double> durations_;
+    bool is_recording_ = false;
+};
+
+struct Result {
+    string name;
+    // What one sample measures
+    string unit;
+    size_t sample_count = 0;
+    double min = 0;
+    double mean = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+// Nearest-rank percentile of sorted values
+double Percentile(const vector<double>& sorted, double percent) {
+    const size_t rank = static_cast<size_t>(ceil(percent / 100 * sorted.size()));
+    return sorted[min(max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+class Benchmark {
+public:
+    explicit Benchmark(const Config& config) : config_(config) {}
+
+    // Runs body warmup + repetitions times, samples of the warmup runs are dropped
+    void Run(const string& name, const string& unit, const function<void(Samples&)>& body) {
+        if (name.find(config_.filter) == string::npos) {
+            return;
+        }
+        Samples samples;
+        for (int run = 0; run < config_.warmup + config_.repetitions; ++run) {
+            samples.SetRecording(run >= config_.warmup);
+            body(samples);
+        }
+
+        vector<double>& durations = samples.GetDurations();
+        sort(durations.begin(), durations.end());
+        Result result{ name, unit, durations.size() };
+        if (!durations.empty()) {
+            double total = 0;
+            for (const double duration : durations) {
+                total += duration;
+            }
+            result.min = durations.front();
+            result.mean = total / durations.size();
+            result.p50 = Percentile(durations, 50);
+            result.p90 = Percentile(durations, 90);
+            result.p99 = Percentile(durations, 99);
+            result.max = durations.back();
+        }
+        cerr << left << setw(36) << name << " p50 " << right << setw(12) << fixed << setprecision(0) << result.p50
+            << " ns  p99 " << setw(12) << result.p99 << " ns  per " << unit << endl;
+        results_.push_back(move(result));
+    }
+
+    void PrintJson(ostream& out) const {
+        out << "{\n  \"config\": {"
+            << "\"seed\": " << config_.seed
+            << ", \"documents\": " << config_.document_count
+            << ", \"dictionary\": " << config_.dictionary_size
+            << ", \"max_word_length\": " << config_.max_word_length
+            << ", \"document_words\": " << config_.document_word_count
+            << ", \"duplicates\": " << config_.duplicate_share
+            << ", \"queries\": " << config_.query_count
+            << ", \"query_words\": " << config_.query_word_count
+            << ", \"minus_prob\": " << config_.minus_word_prob
+            << ", \"zipf\": " << config_.zipf_exponent
+            << ", \"warmup\": " << config_.warmup
+            << ", \"repetitions\": " << config_.repetitions
+            << ", \"filter\": \"" << config_.filter << "\""
+            << "},\n  \"benchmarks\": [";
+        out << fixed << setprecision(0);
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const Result& result = results_[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    {\"name\": \"" << result.name << "\", \"unit\": \"" << result.unit << "\", \"samples\": " << result.sample_count
+                << ", \"min_ns\": " << result.min << ", \"mean_ns\": " << result.mean << ", \"p50_ns\": " << result.p50
+                << ", \"p90_ns\": " << result.p90 << ", \"p99_ns\": " << result.p99 << ", \"max_ns\": " << result.max << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    const Config& config_;
+    vector<Result> results_;
+};
+
+vector<string> GenerateDocuments(mt19937& generator, const WordSampler& sampler, const Config& config) {
+    vector<string> documents = GenerateQueries(generator, sampler, config.document_count, config.document_word_count);
+    // Copies reorder the words of an earlier document, so only a fingerprint finds them
+    const int duplicate_count = static_cast<int>(config.document_count * config.duplicate_share);
+    for (int i = 0; i < duplicate_count; ++i) {
+        const int copy = uniform_int_distribution<int>(1, config.document_count - 1)(generator);
+        istringstream words_input(documents[uniform_int_distribution<int>(0, copy - 1)(generator)]);
+        vector<string> words{ istream_iterator<string>(words_input), istream_iterator<string>() };
+        shuffle(words.begin(), words.end(), generator);
+        string text;
+        for (const string& word : words) {
+            text += word + ' ';
+        }
+        documents[copy] = move(text);
+    }
+    return documents;
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    try {
+        config = ParseConfig(argc, argv);
+    }
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    mt19937 generator(config.seed);
+    const vector<string> dictionary = GenerateDictionary(generator, config.dictionary_size, config.max_word_length);
+    const WordSampler sampler(dictionary, config.zipf_exponent);
+    const vector<string> documents = GenerateDocuments(generator, sampler, config);
+    const vector<string> queries = GenerateQueries(generator, sampler, config.query_count, config.query_word_count, config.minus_word_prob);
+
+    // The most frequent word is the stop word, as in main.cpp
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+
+    Benchmark benchmark(config);
+
+    benchmark.Run("AddDocument", "document", [&](Samples& samples) {
+        SearchServer server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            samples.Time([&]() {
+                server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+                });
+        }
+        });
+
+    benchmark.Run("FindTopDocuments/seq", "query", [&](Samples& samples) {
+        for (const string& query : queries) {
+            samples.Time([&]() {
+                search_server.FindTopDocuments(execution::seq, query);
+                });
+        }
+        });
+
+    benchmark.Run("FindTopDocuments/par", "query", [&](Samples& samples) {
+        for (const string& query : queries) {
+            samples.Time([&]() {
+                search_server.FindTopDocuments(execution::par, query);
+                });
+        }
+        });
+
+    benchmark.Run("FindTopDocuments/max_score", "query", [&](Samples& samples) {
+        for (const string& query : queries) {
+            samples.Time([&]() {
+                search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, QueryEngine::MAX_SCORE);
+                });
+        }
+        });
+
+    benchmark.Run("FindTopDocuments/bm25", "query", [&](Samples& samples) {
+        for (const string& query : queries) {
+            samples.Time([&]() {
+                search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, QueryEngine::EXHAUSTIVE, Bm25Ranking());
+                });
+        }
+        });
+
+    benchmark.Run("FindTopDocuments/bm25_max_score", "query", [&](Samples& samples) {
+        for (const string& query : queries) {
+            samples.Time([&]() {
+                search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, QueryEngine::MAX_SCORE, Bm25Ranking());
+                });
+        }
+        });
+
+    benchmark.Run("MatchDocument", "query and document", [&](Samples& samples) {
+        mt19937 document_generator(config.seed);
+        for (const string& query : queries) {
+            const int document_id = uniform_int_distribution<int>(0, config.document_count - 1)(document_generator);
+            samples.Time([&]() {
+                search_server.MatchDocument(query, document_id);
+                });
+        }
+        });
+
+    // Highlighting a results page: one query against 50 documents
+    benchmark.Run("MatchDocuments/page", "query and 50 documents", [&](Samples& samples) {
+        mt19937 document_generator(config.seed);
+        for (const string& query : queries) {
+            vector<int> document_ids(50);
+            for (int& document_id : document_ids) {
+                document_id = uniform_int_distribution<int>(0, config.document_count - 1)(document_generator);
+            }
+            samples.Time([&]() {
+                search_server.MatchDocuments(query, document_ids);
+                });
+        }
+        });
+
+    benchmark.Run("RemoveDocument", "document", [&](Samples& samples) {
+        SearchServer server = search_server;
+        vector<int> document_ids(server.begin(), server.end());
+        shuffle(document_ids.begin(), document_ids.end(), mt19937(config.seed));
+        document_ids.resize(document_ids.size() / 10);
+        for (const int document_id : document_ids) {
+            samples.Time([&]() {
+                server.RemoveDocument(document_id);
+                });
+        }
+        });
+
+    benchmark.Run("RemoveDuplicates", "corpus", [&](Samples& samples) {
+        SearchServer server = search_server;
+        // RemoveDuplicates reports every document it removes to cout, which carries the JSON
+        ostringstream report;
+        streambuf* const cout_buffer = cout.rdbuf(report.rdbuf());
+        samples.Time([&]() {
+            RemoveDuplicates(server);
+            });
+        cout.rdbuf(cout_buffer);
+        });
+
+    benchmark.Run("ProcessQueries", "batch of queries", [&](Samples& samples) {
+        samples.Time([&]() {
+            ProcessQueries(search_server, queries);
+            });
+        });
+
+    benchmark.PrintJson(cout);
+}
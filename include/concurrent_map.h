@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+// Map split into independently locked buckets.
+// A key always falls into the same bucket, so threads working with different
+// buckets never wait for each other.
+template <typename Key, typename Value>
+class ConcurrentMap {
+
+    struct Bucket {
+        std::mutex mutex;
+        std::map<Key, Value> map;
+    };
+
+    std::vector<Bucket> buckets_;
+
+    Bucket& GetBucket(const Key& key) {
+        return buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+    }
+
+public:
+    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
+
+    // Holds the bucket lock while the value is being used
+    struct Access {
+        std::lock_guard<std::mutex> guard;
+        Value& ref_to_value;
+
+        Access(const Key& key, Bucket& bucket)
+            : guard(bucket.mutex)
+            , ref_to_value(bucket.map[key]) {
+        }
+    };
+
+    explicit ConcurrentMap(size_t bucket_count) : buckets_(bucket_count == 0 ? 1 : bucket_count) {}
+
+    Access operator[](const Key& key) {
+        return Access(key, GetBucket(key));
+    }
+
+    void erase(const Key& key) {
+        Bucket& bucket = GetBucket(key);
+        std::lock_guard<std::mutex> guard(bucket.mutex);
+        bucket.map.erase(key);
+    }
+
+    // Merges all buckets into one sorted map. Must not race with writers.
+    std::map<Key, Value> BuildOrdinaryMap() {
+        std::map<Key, Value> result;
+        for (Bucket& bucket : buckets_) {
+            std::lock_guard<std::mutex> guard(bucket.mutex);
+            result.insert(bucket.map.begin(), bucket.map.end());
+        }
+        return result;
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "left_right.h"
+#include "search_server.h"
+
+// SearchServer shared between threads. Queries run in parallel with each other and with
+// writes, never lock and always see the index either before or after a whole write.
+// Writes are serialized and applied to two copies of the index, see LeftRight. Sealing,
+// background merges and their installation happen in the first copy written only, the
+// second copy replays the write and then takes over its segments, so both copies share
+// every sealed segment and run each merge once. Slot compaction is the exception: it
+// is rebuilt by both copies before the second one drops its own result.
+// Views returned by MatchDocument and MatchDocuments stay valid for the lifetime of the server.
+class ConcurrentSearchServer {
+public:
+    explicit ConcurrentSearchServer(const SearchServer& search_server) : servers_(search_server) {}
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const {
+        return servers_.Read([&args...](const SearchServer& server) {
+            return server.FindTopDocuments(std::forward<Args>(args)...);
+            });
+    }
+
+    template <typename... Args>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(Args&&... args) const {
+        return servers_.Read([&args...](const SearchServer& server) {
+            return server.MatchDocument(std::forward<Args>(args)...);
+            });
+    }
+
+    template <typename... Args>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(Args&&... args) const {
+        return servers_.Read([&args...](const SearchServer& server) {
+            return server.MatchDocuments(std::forward<Args>(args)...);
+            });
+    }
+
+    // Prepared queries stay valid across writes, both copies of the index resolve words alike
+    PreparedQuery PrepareQuery(std::string_view raw_query) const {
+        return servers_.Read([raw_query](const SearchServer& server) {
+            return server.PrepareQuery(raw_query);
+            });
+    }
+
+    int GetDocumentCount() const {
+        return servers_.Read([](const SearchServer& server) {
+            return server.GetDocumentCount();
+            });
+    }
+
+    // Runs any read-only function on a consistent version of the index
+    template <typename Reader>
+    auto Read(Reader reader) const {
+        return servers_.Read(reader);
+    }
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+        Write([&](SearchServer& server) {
+            server.AddDocument(document_id, document, status, ratings);
+            });
+    }
+
+    template <typename ExecutionPolicy, typename DocumentContainer>
+    void AddDocuments(ExecutionPolicy&& policy, const DocumentContainer& documents) {
+        Write([&](SearchServer& server) {
+            server.AddDocuments(policy, documents);
+            });
+    }
+
+    void RemoveDocument(int document_id) {
+        Write([document_id](SearchServer& server) {
+            server.RemoveDocument(document_id);
+            });
+    }
+
+    template <typename ExecutionPolicy, typename IdContainer>
+    void RemoveDocuments(ExecutionPolicy&& policy, const IdContainer& document_ids) {
+        Write([&](SearchServer& server) {
+            server.RemoveDocuments(policy, document_ids);
+            });
+    }
+
+    // Applies several changes as one write, readers see all of them or none.
+    // The writer is called twice and must make the same changes both times.
+    template <typename Writer>
+    void Write(Writer writer) {
+        servers_.Write(writer, [&writer](SearchServer& server, const SearchServer& changed) {
+            server.ReplayWrite(changed, writer);
+            });
+    }
+
+private:
+    LeftRight<SearchServer> servers_;
+};
@@ -0,0 +1,89 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+std::string GenerateWord(std::mt19937& generator, int max_length) {
+    const int length = std::uniform_int_distribution(1, max_length)(generator);
+    std::string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(static_cast<char>(std::uniform_int_distribution(static_cast<int>('a'), static_cast<int>('z'))(generator)));
+    }
+    return word;
+}
+
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length) {
+    std::vector<std::string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob) {
+    std::string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (std::uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[std::uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return query;
+}
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count) {
+    std::vector<std::string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    }
+    return queries;
+}
+
+WordSampler::WordSampler(const std::vector<std::string>& dictionary, double exponent) : dictionary_(dictionary) {
+    if (dictionary.empty()) {
+        throw std::invalid_argument("dictionary is empty");
+    }
+    double total_weight = 0;
+    cumulative_weights_.reserve(dictionary.size());
+    for (size_t rank = 1; rank <= dictionary.size(); ++rank) {
+        total_weight += 1 / std::pow(static_cast<double>(rank), exponent);
+        cumulative_weights_.push_back(total_weight);
+    }
+}
+
+const std::string& WordSampler::operator()(std::mt19937& generator) const {
+    const double point = std::uniform_real_distribution<>(0, cumulative_weights_.back())(generator);
+    const size_t index = std::upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), point) - cumulative_weights_.begin();
+    return dictionary_[std::min(index, dictionary_.size() - 1)];
+}
+
+std::string GenerateQuery(std::mt19937& generator, const WordSampler& sampler, int word_count, double minus_prob) {
+    std::string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (std::uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += sampler(generator);
+    }
+    return query;
+}
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const WordSampler& sampler, int query_count, int word_count, double minus_prob) {
+    std::vector<std::string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, sampler, word_count, minus_prob));
+    }
+    return queries;
+}
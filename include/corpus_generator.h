@@ -0,0 +1,36 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Random corpora for the demo in main.cpp and for benchmark.cpp. Fixed seeds give the same
+// corpus on every run and every platform with the same standard library.
+
+std::string GenerateWord(std::mt19937& generator, int max_length);
+
+// word_count words of up to max_length lowercase letters, adjacent repeats removed
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+
+// Words are drawn uniformly, each one prefixed with '-' with probability minus_prob
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count);
+
+// Draws dictionary words with probability proportional to 1 / rank^exponent, rank being the
+// position in the dictionary starting from 1. Exponent 0 is uniform, natural text is close to 1.
+class WordSampler {
+public:
+    WordSampler(const std::vector<std::string>& dictionary, double exponent);
+
+    const std::string& operator()(std::mt19937& generator) const;
+
+private:
+    const std::vector<std::string>& dictionary_;
+    // cumulative_weights_[i] is the total weight of words [0, i]
+    std::vector<double> cumulative_weights_;
+};
+
+std::string GenerateQuery(std::mt19937& generator, const WordSampler& sampler, int word_count, double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const WordSampler& sampler, int query_count, int word_count, double minus_prob = 0);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 struct Document {
     Document() = default;
@@ -18,4 +20,12 @@ enum class DocumentStatus {
     IRRELEVANT,
     BANNED,
     REMOVED,
+};
+
+// One document of a SearchServer::AddDocuments batch. The text must outlive the call.
+struct DocumentInput {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
 };
\ No newline at end of file
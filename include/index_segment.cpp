@@ -0,0 +1,112 @@
+#include "index_segment.h"
+
+IndexSegment::IndexSegment(int begin_slot) : begin_slot_(begin_slot), end_slot_(begin_slot) {}
+
+IndexSegment::IndexSegment(const MappedIndex& index) : end_slot_(static_cast<int>(index.GetSlotCount())) {
+    word_freqs_.reserve(index.GetSlotCount());
+    for (int slot = 0; slot < end_slot_; ++slot) {
+        const ArrayView<WordFreq> word_freqs = index.GetWordFreqs(slot);
+        word_freqs_.emplace_back(word_freqs.begin(), word_freqs.end());
+    }
+    for (TermId term_id = 0; term_id < index.GetTermCount(); ++term_id) {
+        const PostingListView postings = index.GetPostings(term_id);
+        if (!postings.empty()) {
+            postings_.emplace_back(term_id, PostingList(postings));
+        }
+    }
+    postings_.shrink_to_fit();
+}
+
+IndexSegment::IndexSegment(std::shared_ptr<const MappedIndex> index)
+    : end_slot_(static_cast<int>(index->GetSlotCount()))
+    , mapped_index_(std::move(index)) {
+}
+
+IndexSegment IndexSegment::Merge(const std::vector<const IndexSegment*>& segments, const std::vector<std::vector<bool>>& deleted,
+    bool compact) {
+    IndexSegment result(segments.front()->begin_slot_);
+
+    // Slot of every document of the current segment in the result, -1 if deleted
+    std::vector<int> new_slots;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const IndexSegment& segment = *segments[i];
+        new_slots.assign(segment.GetSlotCount(), -1);
+        for (int slot = segment.begin_slot_; slot < segment.end_slot_; ++slot) {
+            const bool is_deleted = !deleted[i].empty() && deleted[i][slot - segment.begin_slot_];
+            if (is_deleted && compact) {
+                continue;
+            }
+            std::vector<WordFreq>& word_freqs = result.word_freqs_.emplace_back();
+            if (!is_deleted) {
+                const ArrayView<WordFreq> entries = segment.GetWordFreqs(slot);
+                word_freqs.assign(entries.begin(), entries.end());
+                new_slots[slot - segment.begin_slot_] = result.end_slot_;
+            }
+            ++result.end_slot_;
+        }
+        // Segments come in slot order, so every posting is appended at the tail.
+        // Only the words of the segment are visited, not the whole vocabulary.
+        segment.ForEachPostings([&result, &new_slots, &segment](TermId term_id, const PostingListView& postings) {
+            PostingList* merged = nullptr;
+            for (const auto [slot, term_freq] : postings) {
+                const int new_slot = new_slots[slot - segment.begin_slot_];
+                if (new_slot < 0) {
+                    continue;
+                }
+                if (merged == nullptr) {
+                    merged = &result.postings_[result.FindOrAddTerm(term_id)].second;
+                }
+                merged->Add(new_slot, term_freq);
+            }
+            });
+    }
+
+    result.Seal();
+    return result;
+}
+
+PostingListView IndexSegment::GetPostings(TermId term_id) const {
+    if (mapped_index_) {
+        return term_id < mapped_index_->GetTermCount() ? mapped_index_->GetPostings(term_id) : PostingListView();
+    }
+    if (!term_positions_.empty()) {
+        const auto it = term_positions_.find(term_id);
+        return it == term_positions_.end() ? PostingListView() : postings_[it->second].second.View();
+    }
+    const auto it = std::lower_bound(postings_.begin(), postings_.end(), term_id, [](const std::pair<TermId, PostingList>& entry, TermId id) {
+        return entry.first < id;
+        });
+    return it == postings_.end() || it->first != term_id ? PostingListView() : it->second.View();
+}
+
+void IndexSegment::AddDocument(std::vector<WordFreq> word_freqs) {
+    for (const auto [term_id, term_freq] : word_freqs) {
+        postings_[FindOrAddTerm(term_id)].second.Add(end_slot_, term_freq);
+    }
+    word_freqs_.push_back(std::move(word_freqs));
+    ++end_slot_;
+}
+
+void IndexSegment::Seal() {
+    // Lists emptied by removals are dropped, the others lose the slack of their growth
+    postings_.erase(std::remove_if(postings_.begin(), postings_.end(), [](const std::pair<TermId, PostingList>& entry) {
+        return entry.second.empty();
+        }), postings_.end());
+    std::sort(postings_.begin(), postings_.end(), [](const std::pair<TermId, PostingList>& lhs, const std::pair<TermId, PostingList>& rhs) {
+        return lhs.first < rhs.first;
+        });
+    for (auto& [_, postings] : postings_) {
+        postings.ShrinkToFit();
+    }
+    postings_.shrink_to_fit();
+    word_freqs_.shrink_to_fit();
+    std::unordered_map<TermId, size_t>().swap(term_positions_);
+}
+
+size_t IndexSegment::FindOrAddTerm(TermId term_id) {
+    const auto [it, inserted] = term_positions_.emplace(term_id, postings_.size());
+    if (inserted) {
+        postings_.emplace_back(term_id, PostingList());
+    }
+    return it->second;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <execution>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mapped_index.h"
+#include "posting_list.h"
+#include "snapshot_io.h"
+#include "term_dictionary.h"
+
+// Part of the index holding the documents of the slots [begin slot, end slot):
+// their forward index and a posting list per word they contain. Term ids are global and
+// postings refer to global slots, so consecutive segments are merged by appending their lists.
+// Only the words present are stored, so a segment costs nothing for the rest of the vocabulary.
+// The open segment of a SearchServer takes new documents and removes them in place,
+// sealed segments are never changed once built and may be shared between threads.
+class IndexSegment {
+public:
+    explicit IndexSegment(int begin_slot = 0);
+
+    // Copies the postings and forward index of a snapshot
+    explicit IndexSegment(const MappedIndex&);
+
+    // Serves the postings and forward index of a snapshot in place
+    explicit IndexSegment(std::shared_ptr<const MappedIndex>);
+
+    // Builds one segment out of consecutive segments, leaving out deleted documents.
+    // deleted[i] is the tombstone bitmap of segments[i], an empty bitmap deletes nothing.
+    // Deleted documents keep their slots unless compact is set: the remaining documents are
+    // then renumbered in slot order from the begin slot of the first segment.
+    static IndexSegment Merge(const std::vector<const IndexSegment*>& segments, const std::vector<std::vector<bool>>& deleted,
+        bool compact = false);
+
+    inline int GetBeginSlot() const noexcept {
+        return begin_slot_;
+    }
+
+    inline int GetEndSlot() const noexcept {
+        return end_slot_;
+    }
+
+    inline size_t GetSlotCount() const noexcept {
+        return end_slot_ - begin_slot_;
+    }
+
+    // Empty for the words the segment lacks
+    PostingListView GetPostings(TermId term_id) const;
+
+    // Calls handler(TermId, const PostingListView&) for every word with postings in the segment
+    template <typename Handler>
+    void ForEachPostings(Handler handler) const;
+
+    inline ArrayView<WordFreq> GetWordFreqs(int slot) const {
+        return mapped_index_ ? mapped_index_->GetWordFreqs(slot) : ArrayView<WordFreq>(word_freqs_[slot - begin_slot_]);
+    }
+
+    // Puts a document into the end slot, entries must be sorted by term id
+    void AddDocument(std::vector<WordFreq> word_freqs);
+
+    // Sorts the posting lists by term id and releases the lookup table, called when the open
+    // segment stops taking documents
+    void Seal();
+
+    // Every posting list touched by the batch is extended by one task
+    template <typename ExecutionPolicy>
+    void AddDocuments(ExecutionPolicy&&, std::vector<std::vector<WordFreq>> batch);
+
+    // Only the posting lists of the document's own words are re-encoded
+    template <typename ExecutionPolicy>
+    void RemoveDocument(ExecutionPolicy&&, int slot);
+
+    // Erasures are grouped by word, so every posting list is re-encoded once
+    template <typename ExecutionPolicy>
+    void RemoveDocuments(ExecutionPolicy&&, const std::vector<int>& slots);
+
+private:
+    int begin_slot_ = 0;
+    int end_slot_ = 0;
+    // Indexed by slot - begin_slot_, entries are sorted by term id
+    std::vector<std::vector<WordFreq>> word_freqs_;
+    // Words present in the segment and their postings. Sorted by term id once sealed,
+    // in order of first occurrence while the segment takes documents.
+    std::vector<std::pair<TermId, PostingList>> postings_;
+    // Position of every word in postings_ until the segment is sealed, empty afterwards
+    std::unordered_map<TermId, size_t> term_positions_;
+    // Set when the segment serves a mapped snapshot, the vectors above are then empty
+    std::shared_ptr<const MappedIndex> mapped_index_;
+
+    // Position of a word in postings_, the word is added on first use
+    size_t FindOrAddTerm(TermId term_id);
+};
+
+template <typename Handler>
+void IndexSegment::ForEachPostings(Handler handler) const {
+    if (mapped_index_) {
+        for (TermId term_id = 0; term_id < mapped_index_->GetTermCount(); ++term_id) {
+            const PostingListView postings = mapped_index_->GetPostings(term_id);
+            if (!postings.empty()) {
+                handler(term_id, postings);
+            }
+        }
+        return;
+    }
+    for (const auto& [term_id, postings] : postings_) {
+        handler(term_id, postings.View());
+    }
+}
+
+template <typename ExecutionPolicy>
+void IndexSegment::AddDocuments(ExecutionPolicy&& policy, std::vector<std::vector<WordFreq>> batch) {
+    // New slots follow all existing ones, hence walking the batch in order leaves every term's postings sorted.
+    // Postings are grouped by their position in postings_, which only grows here.
+    std::unordered_map<size_t, std::vector<Posting>> new_postings;
+    for (std::vector<WordFreq>& word_freqs : batch) {
+        for (const auto [term_id, term_freq] : word_freqs) {
+            new_postings[FindOrAddTerm(term_id)].push_back({ end_slot_, term_freq });
+        }
+        word_freqs_.push_back(std::move(word_freqs));
+        ++end_slot_;
+    }
+
+    std::vector<std::pair<size_t, std::vector<Posting>>> touched_terms(
+        std::make_move_iterator(new_postings.begin()), std::make_move_iterator(new_postings.end()));
+    std::for_each(policy, touched_terms.begin(), touched_terms.end(), [this](const std::pair<size_t, std::vector<Posting>>& entry) {
+        PostingList& postings = this->postings_[entry.first].second;
+        for (const auto [slot, term_freq] : entry.second) {
+            postings.Add(slot, term_freq);
+        }
+        });
+}
+
+template <typename ExecutionPolicy>
+void IndexSegment::RemoveDocument(ExecutionPolicy&& policy, int slot) {
+    std::vector<WordFreq>& word_freqs = word_freqs_[slot - begin_slot_];
+    std::for_each(policy, word_freqs.begin(), word_freqs.end(), [this, slot](const WordFreq& word_freq) {
+        this->postings_[this->term_positions_.at(word_freq.term_id)].second.Remove(slot);
+        });
+    std::vector<WordFreq>().swap(word_freqs);
+}
+
+template <typename ExecutionPolicy>
+void IndexSegment::RemoveDocuments(ExecutionPolicy&& policy, const std::vector<int>& slots) {
+    std::map<TermId, std::vector<int>> term_to_slots;
+    for (const int slot : slots) {
+        std::vector<WordFreq>& word_freqs = word_freqs_[slot - begin_slot_];
+        for (const auto [term_id, _] : word_freqs) {
+            term_to_slots[term_id].push_back(slot);
+        }
+        std::vector<WordFreq>().swap(word_freqs);
+    }
+
+    std::vector<std::pair<TermId, std::vector<int>>> erasures(
+        std::make_move_iterator(term_to_slots.begin()), std::make_move_iterator(term_to_slots.end()));
+    std::for_each(policy, erasures.begin(), erasures.end(), [this](std::pair<TermId, std::vector<int>>& erasure) {
+        std::sort(erasure.second.begin(), erasure.second.end());
+        this->postings_[this->term_positions_.at(erasure.first)].second.RemoveAll(erasure.second);
+        });
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Two copies of an object giving readers a consistent version without locks or waiting.
+// Readers use the published copy. A writer changes the other copy, publishes it, waits
+// for the grace period in which readers still inside the old copy leave it, then repeats
+// the change on the old copy. Writers are serialized and never block readers.
+// Changes are applied twice, so they must be deterministic. If the first application
+// throws, nothing is published and the copy is expected to be left unchanged.
+template <typename T>
+class LeftRight {
+public:
+    explicit LeftRight(const T& value) : instances_{ value, value } {}
+
+    LeftRight(const LeftRight&) = delete;
+    LeftRight& operator=(const LeftRight&) = delete;
+
+    // Calls reader(const T&) on the published copy, which no writer touches until it returns
+    template <typename Reader>
+    auto Read(Reader reader) const {
+        const size_t version = version_.load();
+        ReadIndicator& indicator = read_indicators_[version];
+        const size_t slot = GetThreadSlot();
+        indicator.Arrive(slot);
+        struct Departure {
+            ReadIndicator& indicator;
+            size_t slot;
+            ~Departure() {
+                indicator.Depart(slot);
+            }
+        } departure{ indicator, slot };
+        return reader(instances_[published_.load()]);
+    }
+
+    // Calls writer(T&) on both copies, the change becomes visible to readers atomically
+    template <typename Writer>
+    void Write(Writer writer) {
+        Write(writer, [&writer](T& instance, const T&) {
+            writer(instance);
+            });
+    }
+
+    // Calls writer(T&) on one copy, publishes it, then repeats the change on the other copy
+    // with replay(T&, const T& changed), which may take over state the first call produced
+    template <typename Writer, typename Replay>
+    void Write(Writer writer, Replay replay) {
+        std::lock_guard guard(writer_mutex_);
+        const size_t published = published_.load();
+        writer(instances_[1 - published]);
+        published_.store(1 - published);
+
+        // Readers that started before the switch may still see the old copy
+        const size_t version = version_.load();
+        WaitForReaders(1 - version);
+        version_.store(1 - version);
+        WaitForReaders(version);
+
+        replay(instances_[published], std::as_const(instances_[1 - published]));
+    }
+
+private:
+    // Readers spread over cache-line sized counters, so that they don't contend
+    inline static constexpr size_t READ_INDICATOR_SLOTS = 64;
+
+    struct alignas(64) Counter {
+        std::atomic<ptrdiff_t> value{ 0 };
+    };
+
+    struct ReadIndicator {
+        std::array<Counter, READ_INDICATOR_SLOTS> counters;
+
+        void Arrive(size_t slot) {
+            counters[slot].value.fetch_add(1);
+        }
+
+        void Depart(size_t slot) {
+            counters[slot].value.fetch_sub(1, std::memory_order_release);
+        }
+
+        bool IsEmpty() const {
+            for (const Counter& counter : counters) {
+                if (counter.value.load() != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    T instances_[2];
+    std::atomic<size_t> published_{ 0 };
+    // Selects the read indicator new readers arrive at
+    std::atomic<size_t> version_{ 0 };
+    mutable std::array<ReadIndicator, 2> read_indicators_;
+    std::mutex writer_mutex_;
+
+    // Threads get slots in turn, so up to READ_INDICATOR_SLOTS threads never share a counter
+    static size_t GetThreadSlot() {
+        static std::atomic<size_t> next_slot{ 0 };
+        thread_local const size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % READ_INDICATOR_SLOTS;
+        return slot;
+    }
+
+    void WaitForReaders(size_t version) const {
+        while (!read_indicators_[version].IsEmpty()) {
+            std::this_thread::yield();
+        }
+    }
+};
@@ -0,0 +1,219 @@
+#include "mapped_index.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void CheckOffsets(ArrayView<uint64_t> offsets, size_t count, size_t payload_size) {
+    if (offsets.size() != count + 1 || offsets[0] != 0 || offsets.back() != payload_size
+        || !std::is_sorted(offsets.begin(), offsets.end())) {
+        throw std::runtime_error("snapshot has corrupted offsets");
+    }
+}
+
+// Decodes the whole list to check what the iterators rely on: every block starts at its skip
+// offset and ends where the next one starts, no varint is longer than an id or runs past the
+// list, ids increase, each block ends on the id the next skip entry records, and every id is
+// a slot of the document table. Runs with verify_checksum off too, so a damaged file can't make
+// a query read out of bounds.
+void CheckPostings(const PostingListView& postings, size_t slot_count) {
+    const auto fail = []() {
+        throw std::runtime_error("snapshot has a corrupted posting list");
+    };
+    const uint8_t* bytes = postings.GetDocumentDeltas();
+    const size_t byte_count = postings.GetDocumentDeltasSize();
+    const size_t skip_count = postings.GetSkipCount();
+    const PostingSkip* skips = postings.GetSkips();
+    if (skip_count != (postings.size() + PostingListView::BLOCK_SIZE - 1) / PostingListView::BLOCK_SIZE
+        || (postings.empty() && byte_count != 0)) {
+        fail();
+    }
+
+    size_t offset = 0;
+    int64_t document_id = -1;
+    for (size_t block = 0; block < skip_count; ++block) {
+        if (skips[block].offset != offset || skips[block].previous_document_id != document_id) {
+            fail();
+        }
+        const size_t block_end = std::min(postings.size(), (block + 1) * PostingListView::BLOCK_SIZE);
+        for (size_t i = block * PostingListView::BLOCK_SIZE; i < block_end; ++i) {
+            uint64_t delta = 0;
+            int shift = 0;
+            uint8_t byte = 0;
+            do {
+                if (offset == byte_count || shift > 28) {
+                    fail();
+                }
+                byte = bytes[offset++];
+                delta |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            document_id += static_cast<int64_t>(delta);
+            if (delta == 0 || static_cast<uint64_t>(document_id) >= slot_count) {
+                fail();
+            }
+        }
+    }
+    if (offset != byte_count) {
+        fail();
+    }
+}
+
+} // namespace
+
+MappedIndex::MappedIndex(const std::string& path, bool verify_checksum) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("can't open snapshot " + path);
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    size_ = static_cast<size_t>(file_size.QuadPart);
+    HANDLE mapping = size_ ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (mapping != nullptr) {
+        data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+    }
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("can't open snapshot " + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        size_ = static_cast<size_t>(file_stat.st_size);
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        data_ = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+    }
+    close(fd);
+#endif
+    if (data_ == nullptr) {
+        throw std::runtime_error("can't map snapshot " + path);
+    }
+
+    try {
+        ReadSections(verify_checksum);
+    }
+    catch (...) {
+        Unmap();
+        throw;
+    }
+}
+
+MappedIndex::~MappedIndex() {
+    Unmap();
+}
+
+void MappedIndex::Unmap() noexcept {
+    if (data_ == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+#else
+    munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+}
+
+void MappedIndex::ReadSections(bool verify_checksum) {
+    SnapshotReader reader(data_, size_, verify_checksum);
+
+    const auto [stop_word_offsets, stop_word_chars] = reader.ReadStrings();
+    for (size_t i = 0; i + 1 < stop_word_offsets.size(); ++i) {
+        stop_words_.emplace_back(stop_word_chars.data() + stop_word_offsets[i], stop_word_offsets[i + 1] - stop_word_offsets[i]);
+    }
+    max_result_document_count_ = reader.Read();
+
+    std::tie(term_offsets_, term_chars_) = reader.ReadStrings();
+    sorted_term_ids_ = reader.ReadArray<TermId>();
+    const size_t term_count = sorted_term_ids_.size();
+    if (term_offsets_.size() != term_count + 1
+        || std::any_of(sorted_term_ids_.begin(), sorted_term_ids_.end(), [term_count](TermId id) { return id >= term_count; })) {
+        throw std::runtime_error("snapshot has a corrupted term dictionary");
+    }
+
+    slot_document_ids_ = reader.ReadArray<int>();
+    slot_ratings_ = reader.ReadArray<int>();
+    slot_statuses_ = reader.ReadArray<DocumentStatus>();
+    slot_lengths_ = reader.ReadArray<uint32_t>();
+    total_document_length_ = reader.Read();
+    documents_ = reader.ReadArray<DocumentSlot>();
+    const size_t slot_count = slot_document_ids_.size();
+    if (slot_ratings_.size() != slot_count || slot_statuses_.size() != slot_count || slot_lengths_.size() != slot_count
+        || std::any_of(documents_.begin(), documents_.end(), [slot_count](const DocumentSlot& document) {
+            return document.slot < 0 || static_cast<size_t>(document.slot) >= slot_count;
+            })
+        || !std::is_sorted(documents_.begin(), documents_.end(), [](const DocumentSlot& lhs, const DocumentSlot& rhs) {
+            return lhs.document_id < rhs.document_id;
+            })) {
+        throw std::runtime_error("snapshot has a corrupted document table");
+    }
+
+    forward_offsets_ = reader.ReadArray<uint64_t>();
+    forward_entries_ = reader.ReadArray<WordFreq>();
+    CheckOffsets(forward_offsets_, slot_count, forward_entries_.size());
+    if (std::any_of(forward_entries_.begin(), forward_entries_.end(), [term_count](const WordFreq& entry) { return entry.term_id >= term_count; })) {
+        throw std::runtime_error("snapshot has a corrupted forward index");
+    }
+
+    posting_byte_offsets_ = reader.ReadArray<uint64_t>();
+    posting_bytes_ = reader.ReadArray<uint8_t>();
+    posting_offsets_ = reader.ReadArray<uint64_t>();
+    posting_freqs_ = reader.ReadArray<float>();
+    skip_offsets_ = reader.ReadArray<uint64_t>();
+    skips_ = reader.ReadArray<PostingSkip>();
+    max_term_freqs_ = reader.ReadArray<float>();
+    term_max_counts_ = reader.ReadArray<uint32_t>();
+    term_min_lengths_ = reader.ReadArray<uint32_t>();
+    CheckOffsets(posting_byte_offsets_, term_count, posting_bytes_.size());
+    CheckOffsets(posting_offsets_, term_count, posting_freqs_.size());
+    CheckOffsets(skip_offsets_, term_count, skips_.size());
+    if (max_term_freqs_.size() != term_count || term_max_counts_.size() != term_count || term_min_lengths_.size() != term_count
+        || !reader.AtEnd()) {
+        throw std::runtime_error("snapshot has a corrupted inverted index");
+    }
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        CheckPostings(GetPostings(term_id), slot_count);
+    }
+}
+
+TermId MappedIndex::FindTerm(std::string_view word) const {
+    const auto it = std::lower_bound(sorted_term_ids_.begin(), sorted_term_ids_.end(), word, [this](TermId term_id, std::string_view value) {
+        return GetTerm(term_id) < value;
+        });
+    if (it == sorted_term_ids_.end() || GetTerm(*it) != word) {
+        return TermDictionary::INVALID_TERM_ID;
+    }
+    return *it;
+}
+
+PostingListView MappedIndex::GetPostings(TermId term_id) const {
+    const uint64_t byte_offset = posting_byte_offsets_[term_id];
+    const uint64_t offset = posting_offsets_[term_id];
+    const uint64_t skip_offset = skip_offsets_[term_id];
+    return PostingListView(
+        posting_bytes_.data() + byte_offset, posting_byte_offsets_[term_id + 1] - byte_offset,
+        posting_freqs_.data() + offset, posting_offsets_[term_id + 1] - offset,
+        skips_.data() + skip_offset, skip_offsets_[term_id + 1] - skip_offset,
+        max_term_freqs_[term_id]);
+}
+
+int MappedIndex::FindSlot(int document_id) const {
+    const auto it = std::lower_bound(documents_.begin(), documents_.end(), document_id, [](const DocumentSlot& document, int id) {
+        return document.document_id < id;
+        });
+    return it != documents_.end() && it->document_id == document_id ? it->slot : -1;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "posting_list.h"
+#include "snapshot_io.h"
+#include "term_dictionary.h"
+
+// External id of a live document and the internal slot it occupies
+struct DocumentSlot {
+    int document_id;
+    int slot;
+};
+
+// Read-only index over a memory-mapped snapshot written by SearchServer::SaveSnapshot.
+// The term dictionary, posting lists, forward index and document table are used in place,
+// so processes mapping the same file share one page-cache copy of it.
+class MappedIndex {
+public:
+    // Maps the file and checks its structure. Verifying the checksum reads the whole file once;
+    // without it every posting list is still decoded once to check that queries stay in bounds.
+    // Throws std::runtime_error if the file is missing, corrupted or of another version.
+    explicit MappedIndex(const std::string& path, bool verify_checksum = true);
+    ~MappedIndex();
+
+    MappedIndex(const MappedIndex&) = delete;
+    MappedIndex& operator=(const MappedIndex&) = delete;
+
+    inline const std::vector<std::string>& GetStopWords() const noexcept {
+        return stop_words_;
+    }
+
+    inline size_t GetMaxResultDocumentCount() const noexcept {
+        return max_result_document_count_;
+    }
+
+    inline size_t GetTermCount() const noexcept {
+        return sorted_term_ids_.size();
+    }
+
+    // O(log V), returns TermDictionary::INVALID_TERM_ID for unknown words
+    TermId FindTerm(std::string_view) const;
+
+    inline std::string_view GetTerm(TermId term_id) const {
+        return std::string_view(term_chars_.data() + term_offsets_[term_id], term_offsets_[term_id + 1] - term_offsets_[term_id]);
+    }
+
+    PostingListView GetPostings(TermId) const;
+
+    inline size_t GetSlotCount() const noexcept {
+        return slot_document_ids_.size();
+    }
+
+    inline const int* GetSlotDocumentIds() const noexcept {
+        return slot_document_ids_.data();
+    }
+
+    inline const int* GetSlotRatings() const noexcept {
+        return slot_ratings_.data();
+    }
+
+    inline const DocumentStatus* GetSlotStatuses() const noexcept {
+        return slot_statuses_.data();
+    }
+
+    inline const uint32_t* GetSlotLengths() const noexcept {
+        return slot_lengths_.data();
+    }
+
+    // Sum of the lengths of the live documents
+    inline uint64_t GetTotalDocumentLength() const noexcept {
+        return total_document_length_;
+    }
+
+    // Indexed by TermId, see SearchServer
+    inline ArrayView<uint32_t> GetTermMaxCounts() const noexcept {
+        return term_max_counts_;
+    }
+
+    inline ArrayView<uint32_t> GetTermMinLengths() const noexcept {
+        return term_min_lengths_;
+    }
+
+    // Live documents sorted by external id
+    inline ArrayView<DocumentSlot> GetDocuments() const noexcept {
+        return documents_;
+    }
+
+    // O(log N), returns -1 for unknown documents
+    int FindSlot(int document_id) const;
+
+    inline ArrayView<WordFreq> GetWordFreqs(int slot) const {
+        return ArrayView<WordFreq>(forward_entries_.data() + forward_offsets_[slot], forward_offsets_[slot + 1] - forward_offsets_[slot]);
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+
+    std::vector<std::string> stop_words_;
+    size_t max_result_document_count_ = 0;
+
+    ArrayView<uint64_t> term_offsets_;
+    ArrayView<char> term_chars_;
+    ArrayView<TermId> sorted_term_ids_;
+
+    ArrayView<int> slot_document_ids_;
+    ArrayView<int> slot_ratings_;
+    ArrayView<DocumentStatus> slot_statuses_;
+    ArrayView<uint32_t> slot_lengths_;
+    uint64_t total_document_length_ = 0;
+    ArrayView<DocumentSlot> documents_;
+
+    ArrayView<uint64_t> forward_offsets_;
+    ArrayView<WordFreq> forward_entries_;
+
+    ArrayView<uint64_t> posting_byte_offsets_;
+    ArrayView<uint8_t> posting_bytes_;
+    ArrayView<uint64_t> posting_offsets_;
+    ArrayView<float> posting_freqs_;
+    ArrayView<uint64_t> skip_offsets_;
+    ArrayView<PostingSkip> skips_;
+    ArrayView<float> max_term_freqs_;
+    ArrayView<uint32_t> term_max_counts_;
+    ArrayView<uint32_t> term_min_lengths_;
+
+    void ReadSections(bool verify_checksum);
+
+    void Unmap() noexcept;
+};
@@ -0,0 +1,194 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    // Position of the highest set bit of a nonzero value
+    int GetHighestBit(uint64_t value) noexcept {
+        int bit = 0;
+        for (int shift = 32; shift > 0; shift /= 2) {
+            if (value >> shift) {
+                value >>= shift;
+                bit += shift;
+            }
+        }
+        return bit;
+    }
+
+    size_t GetShardIndex() noexcept {
+        static std::atomic<size_t> next_index = 0;
+        thread_local const size_t index = next_index.fetch_add(1, std::memory_order_relaxed) % LatencyHistogram::SHARD_COUNT;
+        return index;
+    }
+
+    void PrintJsonString(std::ostream& out, const std::string& text) {
+        out << '"';
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\';
+            }
+            out << c;
+        }
+        out << '"';
+    }
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram() : shards_(std::make_unique<Shard[]>(SHARD_COUNT)) {
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        for (std::atomic<uint64_t>& count : shards_[i].counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        shards_[i].sum.store(0, std::memory_order_relaxed);
+        shards_[i].max.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t value) noexcept {
+    constexpr uint64_t sub_bucket_count = uint64_t(1) << SUB_BUCKET_BITS;
+    if (value < sub_bucket_count) {
+        return static_cast<size_t>(value);
+    }
+    if (value >> MAX_VALUE_BITS) {
+        return BUCKET_COUNT - 1;
+    }
+    // Values in [2^(SUB_BUCKET_BITS + scale - 1), 2^(SUB_BUCKET_BITS + scale)) fall into
+    // sub_bucket_count / 2 buckets of width 2^scale
+    const int scale = GetHighestBit(value) - SUB_BUCKET_BITS + 1;
+    return (static_cast<size_t>(scale) << (SUB_BUCKET_BITS - 1)) + static_cast<size_t>(value >> scale);
+}
+
+uint64_t LatencyHistogram::GetBucketMaxValue(size_t bucket) noexcept {
+    constexpr size_t sub_bucket_count = size_t(1) << SUB_BUCKET_BITS;
+    if (bucket < sub_bucket_count) {
+        return bucket;
+    }
+    const int scale = static_cast<int>(bucket >> (SUB_BUCKET_BITS - 1)) - 1;
+    const uint64_t mantissa = bucket - (static_cast<size_t>(scale) << (SUB_BUCKET_BITS - 1));
+    return ((mantissa + 1) << scale) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds) noexcept {
+    Shard& shard = shards_[GetShardIndex()];
+    shard.counts[GetBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+    uint64_t max = shard.max.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !shard.max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+LatencySummary LatencyHistogram::Summarize() const {
+    std::array<uint64_t, BUCKET_COUNT> counts{};
+    LatencySummary summary;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            const uint64_t count = shards_[i].counts[bucket].load(std::memory_order_relaxed);
+            counts[bucket] += count;
+            summary.count += count;
+        }
+        sum += shards_[i].sum.load(std::memory_order_relaxed);
+        summary.max = std::max(summary.max, shards_[i].max.load(std::memory_order_relaxed));
+    }
+    if (summary.count == 0) {
+        return summary;
+    }
+    summary.mean = static_cast<double>(sum) / summary.count;
+
+    // Nearest rank, reported as the largest value of its bucket but no more than the maximum
+    const std::pair<double, uint64_t*> percentiles[] = {
+        { 50, &summary.p50 }, { 90, &summary.p90 }, { 99, &summary.p99 }, { 99.9, &summary.p999 },
+    };
+    size_t bucket = 0;
+    uint64_t below = counts[0];
+    for (const auto& [percent, value] : percentiles) {
+        const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(percent / 100 * summary.count)), 1);
+        while (below < rank && bucket + 1 < BUCKET_COUNT) {
+            below += counts[++bucket];
+        }
+        *value = std::min(GetBucketMaxValue(bucket), summary.max);
+    }
+    return summary;
+}
+
+Counter& MetricsRegistry::GetCounter(const std::string& name) {
+    std::lock_guard lock(mutex_);
+    std::unique_ptr<Counter>& counter = counters_[name];
+    if (!counter) {
+        counter = std::make_unique<Counter>();
+    }
+    return *counter;
+}
+
+Gauge& MetricsRegistry::GetGauge(const std::string& name) {
+    std::lock_guard lock(mutex_);
+    std::unique_ptr<Gauge>& gauge = gauges_[name];
+    if (!gauge) {
+        gauge = std::make_unique<Gauge>();
+    }
+    return *gauge;
+}
+
+LatencyHistogram& MetricsRegistry::GetHistogram(const std::string& name) {
+    std::lock_guard lock(mutex_);
+    std::unique_ptr<LatencyHistogram>& histogram = histograms_[name];
+    if (!histogram) {
+        histogram = std::make_unique<LatencyHistogram>();
+    }
+    return *histogram;
+}
+
+void MetricsRegistry::PrintText(std::ostream& out) const {
+    std::lock_guard lock(mutex_);
+    for (const auto& [name, counter] : counters_) {
+        out << name << ' ' << counter->Get() << '\n';
+    }
+    for (const auto& [name, gauge] : gauges_) {
+        out << name << ' ' << gauge->Get() << '\n';
+    }
+    for (const auto& [name, histogram] : histograms_) {
+        const LatencySummary summary = histogram->Summarize();
+        out << name << " count=" << summary.count << " mean=" << std::llround(summary.mean)
+            << " p50=" << summary.p50 << " p90=" << summary.p90 << " p99=" << summary.p99
+            << " p999=" << summary.p999 << " max=" << summary.max << '\n';
+    }
+}
+
+void MetricsRegistry::PrintJson(std::ostream& out) const {
+    std::lock_guard lock(mutex_);
+    out << "{\"counters\": {";
+    bool is_first = true;
+    for (const auto& [name, counter] : counters_) {
+        out << (is_first ? "" : ", ");
+        PrintJsonString(out, name);
+        out << ": " << counter->Get();
+        is_first = false;
+    }
+    out << "}, \"gauges\": {";
+    is_first = true;
+    for (const auto& [name, gauge] : gauges_) {
+        out << (is_first ? "" : ", ");
+        PrintJsonString(out, name);
+        out << ": " << gauge->Get();
+        is_first = false;
+    }
+    out << "}, \"histograms\": {";
+    is_first = true;
+    for (const auto& [name, histogram] : histograms_) {
+        const LatencySummary summary = histogram->Summarize();
+        out << (is_first ? "" : ", ");
+        PrintJsonString(out, name);
+        out << ": {\"count\": " << summary.count << ", \"mean_ns\": " << std::llround(summary.mean)
+            << ", \"p50_ns\": " << summary.p50 << ", \"p90_ns\": " << summary.p90 << ", \"p99_ns\": " << summary.p99
+            << ", \"p999_ns\": " << summary.p999 << ", \"max_ns\": " << summary.max << "}";
+        is_first = false;
+    }
+    out << "}}";
+}
+
+MetricsRegistry& MetricsRegistry::GetDefault() {
+    static MetricsRegistry registry;
+    return registry;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+// Monotonic count of events
+class Counter {
+public:
+    inline void Add(uint64_t value = 1) noexcept {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    inline uint64_t Get() const noexcept {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    alignas(64) std::atomic<uint64_t> value_ = 0;
+};
+
+// Current level of something, can go both ways
+class Gauge {
+public:
+    inline void Set(int64_t value) noexcept {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    inline void Add(int64_t value) noexcept {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    inline int64_t Get() const noexcept {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> value_ = 0;
+};
+
+// Percentiles of a LatencyHistogram at some moment, in nanoseconds
+struct LatencySummary {
+    uint64_t count = 0;
+    double mean = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+// HDR-style histogram of durations in nanoseconds. Values below 2^SUB_BUCKET_BITS are counted
+// exactly, larger ones in buckets no wider than 1/64 of their value, up to about 73 minutes.
+// Threads record into one of several shards picked per thread, with relaxed atomic increments
+// only, so recording never locks and rarely shares a cache line with another thread.
+class LatencyHistogram {
+public:
+    inline static constexpr int SUB_BUCKET_BITS = 7;
+    inline static constexpr int MAX_VALUE_BITS = 42;
+    inline static constexpr size_t BUCKET_COUNT = ((MAX_VALUE_BITS - SUB_BUCKET_BITS) + 2) << (SUB_BUCKET_BITS - 1);
+    inline static constexpr size_t SHARD_COUNT = 8;
+
+    LatencyHistogram();
+
+    void Record(uint64_t nanoseconds) noexcept;
+
+    inline void Record(std::chrono::steady_clock::duration duration) noexcept {
+        Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    }
+
+    // Merges the shards. Values recorded meanwhile may be partly included.
+    LatencySummary Summarize() const;
+
+    // Index of the bucket counting the value, and the largest value counted by a bucket
+    static size_t GetBucket(uint64_t value) noexcept;
+    static uint64_t GetBucketMaxValue(size_t bucket) noexcept;
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+};
+
+// Records the time from construction to destruction
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram& histogram) : histogram_(histogram) {}
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer() {
+        histogram_.Record(std::chrono::steady_clock::now() - start_);
+    }
+
+private:
+    LatencyHistogram& histogram_;
+    const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};
+
+// Named metrics. Getting a metric creates it on first use and takes a lock, so callers
+// keep the returned reference, which stays valid for the lifetime of the registry.
+class MetricsRegistry {
+public:
+    Counter& GetCounter(const std::string& name);
+    Gauge& GetGauge(const std::string& name);
+    LatencyHistogram& GetHistogram(const std::string& name);
+
+    // One metric per line: "name value" for counters and gauges,
+    // "name count=... mean=... p50=... p90=... p99=... p999=... max=..." for histograms, in ns
+    void PrintText(std::ostream& out) const;
+
+    // {"counters": {name: value}, "gauges": {name: value}, "histograms": {name: {"count": ..., "p50_ns": ...}}}
+    void PrintJson(std::ostream& out) const;
+
+    // Registry shared by the whole process, SearchServer reports to it
+    static MetricsRegistry& GetDefault();
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Counter>> counters_;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms_;
+};
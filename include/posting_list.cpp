@@ -0,0 +1,175 @@
+#include "posting_list.h"
+
+#include <algorithm>
+
+PostingListView::Iterator::Iterator(const PostingListView& list, size_t index, size_t offset, int previous_document_id)
+    : document_deltas_(list.document_deltas_)
+    , term_freqs_(list.term_freqs_)
+    , skips_(list.skips_)
+    , size_(list.size_)
+    , skip_count_(list.skip_count_)
+    , index_(index)
+    , offset_(offset) {
+    ReadDocumentId(previous_document_id);
+}
+
+void PostingListView::Iterator::ReadDocumentId(int previous_document_id) {
+    if (index_ >= size_) {
+        index_ = size_;
+        return;
+    }
+    uint32_t delta = 0;
+    int shift = 0;
+    uint8_t byte = 0;
+    do {
+        byte = document_deltas_[offset_++];
+        delta |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    document_id_ = previous_document_id + static_cast<int>(delta);
+}
+
+void PostingListView::Iterator::SkipTo(int document_id) {
+    if (index_ == size_ || document_id_ >= document_id) {
+        return;
+    }
+    const size_t next_block = index_ / BLOCK_SIZE + 1;
+    if (next_block < skip_count_ && skips_[next_block].previous_document_id < document_id) {
+        // last block starting after an id less than the requested one
+        const PostingSkip* block = std::partition_point(skips_ + next_block, skips_ + skip_count_, [document_id](const PostingSkip& skip) {
+            return skip.previous_document_id < document_id;
+            }) - 1;
+        index_ = (block - skips_) * BLOCK_SIZE;
+        offset_ = block->offset;
+        ReadDocumentId(block->previous_document_id);
+    }
+    while (index_ != size_ && document_id_ < document_id) {
+        ++*this;
+    }
+}
+
+PostingListView::Iterator PostingListView::LowerBound(int document_id) const {
+    Iterator it = begin();
+    it.SkipTo(document_id);
+    return it;
+}
+
+bool PostingListView::Contains(int document_id) const {
+    const Iterator it = LowerBound(document_id);
+    return it != end() && (*it).document_id == document_id;
+}
+
+PostingListView::Iterator PostingListView::begin() const {
+    return Iterator(*this, 0, 0, -1);
+}
+
+PostingListView::Iterator PostingListView::end() const {
+    return Iterator(*this, size_, 0, -1);
+}
+
+ExclusionCursors::ExclusionCursors(const std::vector<PostingListView>& lists) {
+    cursors_.reserve(lists.size());
+    for (const PostingListView& list : lists) {
+        if (!list.empty()) {
+            cursors_.push_back({ list.begin(), list.end() });
+        }
+    }
+}
+
+PostingList::PostingList(const PostingListView& view)
+    : document_deltas_(view.document_deltas_, view.document_deltas_ + view.document_deltas_size_)
+    , term_freqs_(view.term_freqs_, view.term_freqs_ + view.size_)
+    , skips_(view.skips_, view.skips_ + view.skip_count_)
+    , max_term_freq_(view.max_term_freq_) {
+    for (const Posting posting : view) {
+        last_document_id_ = posting.document_id;
+    }
+}
+
+void PostingList::Add(int document_id, double term_freq) {
+    if (document_id > last_document_id_) {
+        Append(document_id, term_freq);
+        return;
+    }
+
+    std::vector<Posting> postings = Decode();
+    auto it = std::lower_bound(postings.begin(), postings.end(), document_id, [](const Posting& p, int id) {
+        return p.document_id < id;
+        });
+    if (it != postings.end() && it->document_id == document_id) {
+        it->term_freq += term_freq;
+    }
+    else {
+        postings.insert(it, { document_id, term_freq });
+    }
+    Assign(postings);
+}
+
+bool PostingList::Remove(int document_id) {
+    if (!View().Contains(document_id)) {
+        return false;
+    }
+
+    std::vector<Posting> postings = Decode();
+    postings.erase(std::find_if(postings.begin(), postings.end(), [document_id](const Posting& p) {
+        return p.document_id == document_id;
+        }));
+    Assign(postings);
+    return true;
+}
+
+size_t PostingList::RemoveAll(const std::vector<int>& document_ids) {
+    std::vector<Posting> postings = Decode();
+    auto ids_it = document_ids.begin();
+    const auto kept_end = std::remove_if(postings.begin(), postings.end(), [&ids_it, &document_ids](const Posting& p) {
+        ids_it = std::lower_bound(ids_it, document_ids.end(), p.document_id);
+        return ids_it != document_ids.end() && *ids_it == p.document_id;
+        });
+
+    const size_t removed = postings.end() - kept_end;
+    if (removed != 0) {
+        postings.erase(kept_end, postings.end());
+        Assign(postings);
+    }
+    return removed;
+}
+
+void PostingList::ShrinkToFit() {
+    document_deltas_.shrink_to_fit();
+    term_freqs_.shrink_to_fit();
+    skips_.shrink_to_fit();
+}
+
+void PostingList::Append(int document_id, double term_freq) {
+    if (term_freqs_.size() % BLOCK_SIZE == 0) {
+        skips_.push_back({ last_document_id_, static_cast<uint32_t>(document_deltas_.size()) });
+    }
+
+    uint32_t delta = static_cast<uint32_t>(document_id - last_document_id_);
+    while (delta >= 0x80) {
+        document_deltas_.push_back(static_cast<uint8_t>(delta | 0x80));
+        delta >>= 7;
+    }
+    document_deltas_.push_back(static_cast<uint8_t>(delta));
+
+    term_freqs_.push_back(static_cast<float>(term_freq));
+    max_term_freq_ = std::max(max_term_freq_, term_freqs_.back());
+    last_document_id_ = document_id;
+}
+
+std::vector<Posting> PostingList::Decode() const {
+    const PostingListView view = View();
+    return std::vector<Posting>(view.begin(), view.end());
+}
+
+void PostingList::Assign(const std::vector<Posting>& postings) {
+    document_deltas_.clear();
+    term_freqs_.clear();
+    skips_.clear();
+    last_document_id_ = -1;
+    max_term_freq_ = 0;
+    for (const Posting& posting : postings) {
+        Append(posting.document_id, posting.term_freq);
+    }
+    ShrinkToFit();
+}
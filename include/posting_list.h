@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "term_dictionary.h"
+
+struct Posting {
+    int document_id;
+    double term_freq;
+};
+
+// Entry of the forward index: a word of a document and its term frequency.
+// Entries of a document are sorted by term id.
+struct WordFreq {
+    TermId term_id;
+    float term_freq;
+};
+
+// Skip entry recorded at the start of every block of a posting list
+struct PostingSkip {
+    // id of the posting preceding the block, -1 for the first block
+    int previous_document_id;
+    uint32_t offset;
+};
+
+// Read-only view of an encoded posting list. Doesn't own the memory, so it can point
+// into a PostingList or into a memory-mapped snapshot.
+// Document ids are sorted and stored as varint-encoded deltas, term frequencies are
+// stored as floats in a parallel array. Every BLOCK_SIZE postings a skip entry is recorded,
+// so LowerBound only decodes one block after a binary search.
+class PostingListView {
+public:
+    inline static constexpr size_t BLOCK_SIZE = 128;
+
+    class Iterator {
+        friend class PostingListView;
+
+        const uint8_t* document_deltas_ = nullptr;
+        const float* term_freqs_ = nullptr;
+        const PostingSkip* skips_ = nullptr;
+        size_t size_ = 0;
+        size_t skip_count_ = 0;
+        size_t index_ = 0;
+        // offset of the posting following the current one
+        size_t offset_ = 0;
+        int document_id_ = -1;
+
+        Iterator(const PostingListView& list, size_t index, size_t offset, int previous_document_id);
+
+        void ReadDocumentId(int previous_document_id);
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Posting;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Posting*;
+        using reference = Posting;
+
+        Iterator() = default;
+
+        inline Posting operator*() const {
+            return { document_id_, term_freqs_[index_] };
+        }
+
+        inline Iterator& operator++() {
+            ++index_;
+            ReadDocumentId(document_id_);
+            return *this;
+        }
+
+        inline Iterator operator++(int) {
+            Iterator it = *this;
+            ++*this;
+            return it;
+        }
+
+        inline bool operator==(const Iterator& other) const noexcept {
+            return index_ == other.index_;
+        }
+
+        inline bool operator!=(const Iterator& other) const noexcept {
+            return index_ != other.index_;
+        }
+
+        // Moves forward to the first posting with document id not less than the given one.
+        // Stays within the current block when possible, otherwise binary-searches the skip entries.
+        void SkipTo(int document_id);
+    };
+
+    PostingListView() = default;
+
+    PostingListView(const uint8_t* document_deltas, size_t document_deltas_size, const float* term_freqs, size_t size,
+        const PostingSkip* skips, size_t skip_count, float max_term_freq)
+        : document_deltas_(document_deltas)
+        , document_deltas_size_(document_deltas_size)
+        , term_freqs_(term_freqs)
+        , skips_(skips)
+        , size_(size)
+        , skip_count_(skip_count)
+        , max_term_freq_(max_term_freq) {
+    }
+
+    // First posting with document id not less than the given one
+    Iterator LowerBound(int document_id) const;
+
+    bool Contains(int document_id) const;
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    inline size_t size() const noexcept {
+        return size_;
+    }
+
+    inline bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    // Upper bound of the term frequencies in the list, used for dynamic pruning
+    inline double GetMaxTermFreq() const noexcept {
+        return max_term_freq_;
+    }
+
+    // Encoded data, as written to snapshots
+    inline const uint8_t* GetDocumentDeltas() const noexcept {
+        return document_deltas_;
+    }
+
+    inline size_t GetDocumentDeltasSize() const noexcept {
+        return document_deltas_size_;
+    }
+
+    inline const float* GetTermFreqs() const noexcept {
+        return term_freqs_;
+    }
+
+    inline const PostingSkip* GetSkips() const noexcept {
+        return skips_;
+    }
+
+    inline size_t GetSkipCount() const noexcept {
+        return skip_count_;
+    }
+
+private:
+    friend class PostingList;
+
+    const uint8_t* document_deltas_ = nullptr;
+    size_t document_deltas_size_ = 0;
+    const float* term_freqs_ = nullptr;
+    const PostingSkip* skips_ = nullptr;
+    size_t size_ = 0;
+    size_t skip_count_ = 0;
+    float max_term_freq_ = 0;
+};
+
+// Cursors over excluded lists advanced along an ascending sequence of document ids
+class ExclusionCursors {
+public:
+    explicit ExclusionCursors(const std::vector<PostingListView>& lists);
+
+    // True if no list has postings
+    inline bool empty() const noexcept {
+        return cursors_.empty();
+    }
+
+    // Document ids must not decrease between calls
+    inline bool IsExcluded(int document_id) {
+        for (Cursor& cursor : cursors_) {
+            cursor.it.SkipTo(document_id);
+            if (cursor.it != cursor.end && (*cursor.it).document_id == document_id) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Cursor {
+        PostingListView::Iterator it;
+        PostingListView::Iterator end;
+    };
+
+    std::vector<Cursor> cursors_;
+};
+
+// Set operations over posting lists. Lists are walked in document id order and iterators
+// move with SkipTo, which binary-searches the skip entries for far targets, so a short list
+// against a long one decodes at most a block of the long one per posting instead of all of it.
+// Ids are varint-coded, so the kernels compare them one by one rather than with SIMD.
+
+// Calls handler(posting) for every posting of list whose document is in none of excluded
+template <typename Handler>
+void ForEachPostingExcept(const PostingListView& list, const std::vector<PostingListView>& excluded, Handler handler);
+
+// Calls handler(document_id, term_freqs) for every document present in all lists and in none
+// of excluded, term_freqs[i] being its frequency in lists[i]. Lists may come in any order,
+// the shortest one drives the intersection. Nothing is called if lists is empty.
+template <typename Handler>
+void ForEachIntersection(const std::vector<PostingListView>& lists, const std::vector<PostingListView>& excluded, Handler handler);
+
+template <typename Handler>
+void ForEachPostingExcept(const PostingListView& list, const std::vector<PostingListView>& excluded, Handler handler) {
+    ExclusionCursors exclusion(excluded);
+    if (exclusion.empty()) {
+        for (const Posting posting : list) {
+            handler(posting);
+        }
+        return;
+    }
+    for (const Posting posting : list) {
+        if (!exclusion.IsExcluded(posting.document_id)) {
+            handler(posting);
+        }
+    }
+}
+
+template <typename Handler>
+void ForEachIntersection(const std::vector<PostingListView>& lists, const std::vector<PostingListView>& excluded, Handler handler) {
+    if (lists.empty()) {
+        return;
+    }
+    // Leapfrog: the shortest list proposes a document, the others skip to it,
+    // and any list overshooting it proposes the next one
+    std::vector<size_t> order(lists.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+        if (lists[i].empty()) {
+            return;
+        }
+    }
+    std::sort(order.begin(), order.end(), [&lists](size_t lhs, size_t rhs) {
+        return lists[lhs].size() < lists[rhs].size();
+        });
+    std::vector<PostingListView::Iterator> its;
+    for (const size_t i : order) {
+        its.push_back(lists[i].begin());
+    }
+
+    ExclusionCursors exclusion(excluded);
+    std::vector<double> term_freqs(lists.size());
+    PostingListView::Iterator& driver = its[0];
+    const PostingListView::Iterator driver_end = lists[order[0]].end();
+    while (driver != driver_end) {
+        const int document_id = (*driver).document_id;
+        int next_document_id = document_id;
+        for (size_t i = 1; i < its.size(); ++i) {
+            its[i].SkipTo(document_id);
+            if (its[i] == lists[order[i]].end()) {
+                return;
+            }
+            if ((*its[i]).document_id != document_id) {
+                next_document_id = (*its[i]).document_id;
+                break;
+            }
+        }
+        if (next_document_id != document_id) {
+            driver.SkipTo(next_document_id);
+            continue;
+        }
+        if (!exclusion.IsExcluded(document_id)) {
+            for (size_t i = 0; i < its.size(); ++i) {
+                term_freqs[order[i]] = (*its[i]).term_freq;
+            }
+            handler(document_id, term_freqs);
+        }
+        ++driver;
+    }
+}
+
+// Inverted list of one word: documents containing it and the word's term frequency in each.
+// Owns the encoded data, reading goes through PostingListView.
+class PostingList {
+public:
+    using Posting = ::Posting;
+    using Iterator = PostingListView::Iterator;
+
+    inline static constexpr size_t BLOCK_SIZE = PostingListView::BLOCK_SIZE;
+
+    PostingList() = default;
+
+    // Copies the encoded data of a view
+    explicit PostingList(const PostingListView&);
+
+    // O(1) amortized when document ids arrive in ascending order, O(N) otherwise.
+    // The frequency is added up if the document is already present.
+    void Add(int document_id, double term_freq);
+
+    // Returns false if the document is not in the list
+    bool Remove(int document_id);
+
+    // Removes every listed document with a single re-encoding, ids must be sorted.
+    // Returns the number of postings removed.
+    size_t RemoveAll(const std::vector<int>& document_ids);
+
+    // Valid until the list is changed
+    inline PostingListView View() const noexcept {
+        return PostingListView(document_deltas_.data(), document_deltas_.size(), term_freqs_.data(), term_freqs_.size(),
+            skips_.data(), skips_.size(), max_term_freq_);
+    }
+
+    inline size_t size() const noexcept {
+        return term_freqs_.size();
+    }
+
+    inline bool empty() const noexcept {
+        return term_freqs_.empty();
+    }
+
+    inline double GetMaxTermFreq() const noexcept {
+        return max_term_freq_;
+    }
+
+    // Releases the spare capacity left by appends, for lists that won't grow anymore
+    void ShrinkToFit();
+
+private:
+    std::vector<uint8_t> document_deltas_;
+    std::vector<float> term_freqs_;
+    std::vector<PostingSkip> skips_;
+    int last_document_id_ = -1;
+    float max_term_freq_ = 0;
+
+    void Append(int document_id, double term_freq);
+
+    std::vector<Posting> Decode() const;
+
+    void Assign(const std::vector<Posting>& postings);
+};
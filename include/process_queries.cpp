@@ -1,11 +1,94 @@
 #include "process_queries.h"
 
+QueryProcessor::QueryProcessor(const SearchServer& search_server, ResultHandler handler, size_t max_in_flight, ThreadPool& pool)
+	: search_server_(search_server)
+	, handler_(std::move(handler))
+	, pool_(pool)
+	, window_(std::max<size_t>(max_in_flight, 1)) {
+}
+
+QueryProcessor::~QueryProcessor() {
+	std::unique_lock lock(mutex_);
+	result_ready_.wait(lock, [this]() {
+		return completed_count_ == pushed_count_;
+		});
+}
+
+void QueryProcessor::Push(std::string query) {
+	std::unique_lock lock(mutex_);
+	while (true) {
+		DeliverReady(lock);
+		if (pushed_count_ - delivered_count_ < window_.size()) {
+			break;
+		}
+		result_ready_.wait(lock);
+	}
+	const size_t index = pushed_count_++;
+	lock.unlock();
+
+	pool_.Submit([this, index, query = std::move(query)]() {
+		std::vector<Document> result;
+		std::exception_ptr error;
+		try {
+			result = search_server_.FindTopDocuments(query);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		{
+			std::lock_guard guard(mutex_);
+			window_[index % window_.size()] = std::move(result);
+			if (error && !error_) {
+				error_ = error;
+			}
+			++completed_count_;
+			// Notified under the lock, so the destructor can't run before this task stops using the processor
+			result_ready_.notify_all();
+		}
+		});
+}
+
+void QueryProcessor::Finish() {
+	std::unique_lock lock(mutex_);
+	while (true) {
+		DeliverReady(lock);
+		if (delivered_count_ == pushed_count_) {
+			break;
+		}
+		result_ready_.wait(lock);
+	}
+	if (error_) {
+		std::rethrow_exception(std::exchange(error_, nullptr));
+	}
+}
+
+void QueryProcessor::DeliverReady(std::unique_lock<std::mutex>& lock) {
+	while (delivered_count_ < pushed_count_) {
+		std::optional<std::vector<Document>>& slot = window_[delivered_count_ % window_.size()];
+		if (!slot) {
+			return;
+		}
+		std::vector<Document> result = std::move(*slot);
+		slot.reset();
+		++delivered_count_;
+
+		lock.unlock();
+		handler_(std::move(result));
+		lock.lock();
+	}
+}
+
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
-	std::vector<std::vector<Document>> result(queries.size());
+	std::vector<std::vector<Document>> result;
+	result.reserve(queries.size());
 
-	std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](const std::string& request) {
-		return search_server.FindTopDocuments(request);
+	QueryProcessor processor(search_server, [&result](std::vector<Document> documents) {
+		result.push_back(std::move(documents));
 		});
+	for (const std::string& query : queries) {
+		processor.Push(query);
+	}
+	processor.Finish();
 
 	return result;
 }
@@ -13,8 +96,12 @@ std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_ser
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
 
 	std::vector<Document> result;
-	for (auto v : ProcessQueries(search_server, queries)) {
-		std::copy(v.begin(), v.end(), std::back_inserter(result));
+	QueryProcessor processor(search_server, [&result](std::vector<Document> documents) {
+		result.insert(result.end(), std::make_move_iterator(documents.begin()), std::make_move_iterator(documents.end()));
+		});
+	for (const std::string& query : queries) {
+		processor.Push(query);
 	}
+	processor.Finish();
 	return result;
-}
\ No newline at end of file
+}
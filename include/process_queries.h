@@ -1,10 +1,59 @@
 #pragma once
 
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <vector>
 #include <execution>
 
 #include "search_server.h"
 #include "document.h"
+#include "thread_pool.h"
+
+// Default number of queries a QueryProcessor keeps queued, running or undelivered
+const size_t QUERY_WINDOW = 256;
+
+// Streams queries through a thread pool. Results are handed to the handler in the order
+// the queries were pushed, on the thread calling Push or Finish, as soon as all earlier
+// results are ready. At most max_in_flight queries are pending, Push blocks beyond that.
+// Push and Finish must be called from one thread, which must not be a worker of the pool.
+class QueryProcessor {
+public:
+	using ResultHandler = std::function<void(std::vector<Document>)>;
+
+	QueryProcessor(const SearchServer&, ResultHandler, size_t max_in_flight = QUERY_WINDOW, ThreadPool& = ThreadPool::GetDefault());
+
+	// Waits for the queries still running, their results are dropped
+	~QueryProcessor();
+
+	QueryProcessor(const QueryProcessor&) = delete;
+	QueryProcessor& operator=(const QueryProcessor&) = delete;
+
+	void Push(std::string query);
+
+	// Delivers every remaining result. Rethrows the first exception thrown by a query.
+	void Finish();
+
+private:
+	const SearchServer& search_server_;
+	ResultHandler handler_;
+	ThreadPool& pool_;
+
+	std::mutex mutex_;
+	std::condition_variable result_ready_;
+	// Result of query i is kept in window_[i % window_.size()] until delivered
+	std::vector<std::optional<std::vector<Document>>> window_;
+	size_t pushed_count_ = 0;
+	size_t delivered_count_ = 0;
+	size_t completed_count_ = 0;
+	std::exception_ptr error_;
+
+	// Hands over results in order while they are ready, the lock is released around the handler
+	void DeliverReady(std::unique_lock<std::mutex>&);
+};
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
-std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
+std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
@@ -0,0 +1,84 @@
+#include "query_cache.h"
+
+QueryCache::QueryCache(size_t capacity)
+    : capacity_(capacity)
+    , shard_capacity_((capacity + QUERY_CACHE_SHARD_COUNT - 1) / QUERY_CACHE_SHARD_COUNT)
+    , shards_(capacity > 0 ? QUERY_CACHE_SHARD_COUNT : 0) {
+}
+
+QueryCache::QueryCache(const QueryCache& other) : QueryCache(other.capacity_) {}
+
+QueryCache& QueryCache::operator=(const QueryCache& other) {
+    if (this != &other) {
+        capacity_ = other.capacity_;
+        shard_capacity_ = other.shard_capacity_;
+        shards_ = std::vector<Shard>(other.shards_.size());
+        hits_ = 0;
+        misses_ = 0;
+    }
+    return *this;
+}
+
+std::optional<std::vector<Document>> QueryCache::Find(const Key& key, uint64_t generation) {
+    Shard& shard = shards_[KeyHash()(key) % shards_.size()];
+    std::lock_guard guard(shard.mutex);
+
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        ++misses_;
+        return std::nullopt;
+    }
+    if (it->second->generation != generation) {
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+        ++misses_;
+        return std::nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    ++hits_;
+    return it->second->documents;
+}
+
+void QueryCache::Insert(Key key, uint64_t generation, std::vector<Document> documents) {
+    Shard& shard = shards_[KeyHash()(key) % shards_.size()];
+    std::lock_guard guard(shard.mutex);
+
+    const auto [it, inserted] = shard.index.emplace(std::move(key), shard.entries.end());
+    if (!inserted) {
+        // Computed concurrently by another thread or at another generation
+        it->second->generation = generation;
+        it->second->documents = std::move(documents);
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    shard.entries.push_front({ &it->first, generation, std::move(documents) });
+    it->second = shard.entries.begin();
+
+    if (shard.entries.size() > shard_capacity_) {
+        shard.index.erase(*shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+}
+
+QueryCache::Stats QueryCache::GetStats() const noexcept {
+    return { hits_.load(), misses_.load() };
+}
+
+size_t QueryCache::KeyHash::operator()(const Key& key) const noexcept {
+    // FNV-1a over the term ids, the boundary between plus and minus words and the flags
+    uint64_t hash = 14695981039346656037ull;
+    const auto mix = [&hash](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    for (const TermId term_id : key.plus_words) {
+        mix(term_id);
+    }
+    mix(key.plus_words.size());
+    for (const TermId term_id : key.minus_words) {
+        mix(term_id);
+    }
+    mix(static_cast<uint64_t>(key.filter));
+    mix(key.is_conjunctive);
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
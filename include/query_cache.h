@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "term_dictionary.h"
+
+// Number of independently locked parts of a QueryCache
+const size_t QUERY_CACHE_SHARD_COUNT = 16;
+
+// Top documents of recent queries, split into shards with a lock and an LRU list each.
+// Entries are tagged with the index generation they were computed at and are dropped
+// when looked up at another one, so changing the index invalidates the whole cache at once.
+// Copies get the same capacity and no entries: results belong to one index.
+class QueryCache {
+public:
+    // Canonical form of a query: sorted, deduplicated term ids, the document filter and the matching mode
+    struct Key {
+        std::vector<TermId> plus_words;
+        std::vector<TermId> minus_words;
+        int filter = 0;
+        bool is_conjunctive = false;
+
+        bool operator==(const Key& other) const {
+            return filter == other.filter && is_conjunctive == other.is_conjunctive
+                && plus_words == other.plus_words && minus_words == other.minus_words;
+        }
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // Capacity 0 disables the cache
+    explicit QueryCache(size_t capacity = 0);
+
+    QueryCache(const QueryCache&);
+    QueryCache& operator=(const QueryCache&);
+
+    inline bool IsEnabled() const noexcept {
+        return capacity_ > 0;
+    }
+
+    inline size_t GetCapacity() const noexcept {
+        return capacity_;
+    }
+
+    std::optional<std::vector<Document>> Find(const Key&, uint64_t generation);
+
+    void Insert(Key, uint64_t generation, std::vector<Document>);
+
+    Stats GetStats() const noexcept;
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key&) const noexcept;
+    };
+
+    struct Entry {
+        // Points into the shard index, whose nodes never move
+        const Key* key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // Most recently used first
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    };
+
+    size_t capacity_ = 0;
+    size_t shard_capacity_ = 0;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+};
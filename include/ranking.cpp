@@ -0,0 +1,17 @@
+#include "ranking.h"
+
+#include <stdexcept>
+
+Bm25Ranking::Bm25Ranking(double k1, double b) : k1_(k1), b_(b) {
+    if (!(k1 >= 0) || !(b >= 0 && b <= 1)) {
+        throw std::invalid_argument("BM25 needs k1 >= 0 and b in [0, 1]");
+    }
+}
+
+Bm25Ranking::Scorer::Scorer(const Bm25Ranking& ranking, const CollectionStats& stats)
+    : document_count_(stats.document_count)
+    , k1_plus_one_(ranking.GetK1() + 1)
+    , length_norm_base_(ranking.GetK1() * (1 - ranking.GetB()))
+    // Without documents nothing is scored, the slope only has to be finite
+    , length_norm_slope_(stats.average_document_length > 0 ? ranking.GetK1() * ranking.GetB() / stats.average_document_length : 0) {
+}
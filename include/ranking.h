@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Index statistics a ranking function may use, taken once per query
+struct CollectionStats {
+    int document_count = 0;
+    double average_document_length = 0;
+};
+
+// Upper bounds on the postings of a word, for dynamic pruning
+struct TermBounds {
+    // Largest term frequency in the posting list
+    double max_term_freq = 0;
+    // Largest number of times the word occurs in one document of the index
+    uint32_t max_word_count = 0;
+    // Length of the shortest document of the index containing the word
+    uint32_t min_document_length = 0;
+};
+
+// Ranking functions score a document by summing, over the query words it contains,
+// Scorer::Score(weight of the word, its term frequency in the document, document length).
+// Lengths count the non-stop words of a document and are recorded when it is added.
+// A ranking is a template parameter of the scoring path, chosen by the FindTopDocuments
+// overload, so switching rankings costs nothing at run time. A Scorer is the ranking bound
+// to the statistics of one query and provides:
+//     double ComputeWeight(int document_freq) const;
+//     double Score(double weight, double term_freq, uint32_t document_length) const;
+//     double ComputeScoreBound(double weight, const TermBounds&) const;
+
+// Term frequency times log(N / document frequency), the default
+class TfIdfRanking {
+public:
+    class Scorer {
+    public:
+        explicit Scorer(const CollectionStats& stats) : document_count_(stats.document_count) {}
+
+        inline double ComputeWeight(int document_freq) const {
+            return std::log(document_count_ * 1.0 / document_freq);
+        }
+
+        inline double Score(double weight, double term_freq, uint32_t) const {
+            return term_freq * weight;
+        }
+
+        inline double ComputeScoreBound(double weight, const TermBounds& bounds) const {
+            return bounds.max_term_freq * weight;
+        }
+
+    private:
+        int document_count_;
+    };
+
+    inline Scorer MakeScorer(const CollectionStats& stats) const {
+        return Scorer(stats);
+    }
+};
+
+// Okapi BM25. k1 controls how quickly repeats of a word stop adding to the score,
+// b how much a document's length relative to the average one discounts its words.
+class Bm25Ranking {
+public:
+    // Throws std::invalid_argument unless k1 >= 0 and 0 <= b <= 1
+    explicit Bm25Ranking(double k1 = 1.2, double b = 0.75);
+
+    class Scorer {
+    public:
+        Scorer(const Bm25Ranking& ranking, const CollectionStats& stats);
+
+        inline double ComputeWeight(int document_freq) const {
+            return std::log(1 + (document_count_ - document_freq + 0.5) / (document_freq + 0.5));
+        }
+
+        // Word counts are recovered from term frequencies, which are counts divided by length
+        inline double Score(double weight, double term_freq, uint32_t document_length) const {
+            const double word_count = term_freq * document_length;
+            return weight * word_count * k1_plus_one_ / (word_count + length_norm_base_ + length_norm_slope_ * document_length);
+        }
+
+        // The score grows with the word count and falls with the document length
+        inline double ComputeScoreBound(double weight, const TermBounds& bounds) const {
+            const double word_count = bounds.max_word_count;
+            return weight * word_count * k1_plus_one_ / (word_count + length_norm_base_ + length_norm_slope_ * bounds.min_document_length);
+        }
+
+    private:
+        double document_count_;
+        double k1_plus_one_;
+        // k1 * (1 - b + b * length / average length) = base + slope * length
+        double length_norm_base_;
+        double length_norm_slope_;
+    };
+
+    inline Scorer MakeScorer(const CollectionStats& stats) const {
+        return Scorer(*this, stats);
+    }
+
+    inline double GetK1() const noexcept {
+        return k1_;
+    }
+
+    inline double GetB() const noexcept {
+        return b_;
+    }
+
+private:
+    double k1_;
+    double b_;
+};
@@ -1,28 +1,75 @@
 #include "remove_duplicates.h"
 
+#include <cmath>
+#include <limits>
+
+std::vector<int> FindDuplicates(const SearchServer& search_server) {
+    return FindDuplicates(std::execution::seq, search_server);
+}
+
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, double similarity) {
+    return FindNearDuplicates(std::execution::seq, search_server, similarity);
+}
+
 void RemoveDuplicates(SearchServer& search_server) {
 
-    std::set<int> duplicates;
-    std::map<std::set<std::string>, int> temp;
+    const std::vector<int> duplicates = FindDuplicates(std::execution::par, search_server);
+    for (const int id : duplicates) {
+        std::cout << "Found duplicate document id " << id << "\n";
+    }
+
+    search_server.RemoveDocuments(std::execution::par, duplicates);
+}
 
-    for (const int id : search_server) {
-        const std::map<std::string, double>& doc = search_server.GetWordFrequencies(id);
-        std::set<std::string> content;
-        
-        std::transform(doc.begin(), doc.end(), std::inserter(content, content.begin()), [](const std::pair<std::string, double>& d) {
-            return d.first;
-            });
+void RemoveNearDuplicates(SearchServer& search_server, double similarity) {
+    search_server.RemoveDocuments(std::execution::par, FindNearDuplicates(std::execution::par, search_server, similarity));
+}
 
-        if (temp.count(content)) {
-            std::cout << "Found duplicate document id " << id << "\n";
-            duplicates.emplace(id);
+std::vector<uint64_t> ComputeMinHash(const std::vector<TermId>& terms) {
+    std::vector<uint64_t> min_hash(MIN_HASH_SIZE, std::numeric_limits<uint64_t>::max());
+    for (const TermId term_id : terms) {
+        for (size_t i = 0; i < MIN_HASH_SIZE; ++i) {
+            // splitmix64 of the term id in the i-th sequence
+            uint64_t hash = term_id + (i + 1) * 0x9e3779b97f4a7c15ull;
+            hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+            hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+            min_hash[i] = std::min(min_hash[i], hash ^ (hash >> 31));
+        }
+    }
+    return min_hash;
+}
+
+double ComputeJaccardSimilarity(const std::vector<TermId>& lhs, const std::vector<TermId>& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1;
+    }
+    size_t common = 0;
+    for (auto l = lhs.begin(), r = rhs.begin(); l != lhs.end() && r != rhs.end();) {
+        if (*l < *r) {
+            ++l;
+        }
+        else if (*r < *l) {
+            ++r;
         }
         else {
-            temp.emplace(content, id);
+            ++common;
+            ++l;
+            ++r;
         }
     }
+    return static_cast<double>(common) / (lhs.size() + rhs.size() - common);
+}
 
-    for (const int id : duplicates) {
-        search_server.RemoveDocument(id);
+size_t ComputeBandRows(double similarity) {
+    // A pair is a candidate with probability 1 - (1 - s^rows)^bands, which rises steeply
+    // around (1 / bands)^(1 / rows). That point is kept 0.1 below the threshold for recall.
+    size_t band_rows = 1;
+    for (size_t rows = 2; rows <= MIN_HASH_SIZE; rows *= 2) {
+        const double band_count = static_cast<double>(MIN_HASH_SIZE / rows);
+        if (std::pow(1 / band_count, 1 / static_cast<double>(rows)) > similarity - 0.1) {
+            break;
+        }
+        band_rows = rows;
     }
-}
\ No newline at end of file
+    return band_rows;
+}
@@ -1,5 +1,152 @@
 #pragma once
 
+#include <algorithm>
+#include <execution>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer&);
\ No newline at end of file
+// Number of hashes in a MinHash signature
+const size_t MIN_HASH_SIZE = 128;
+
+// Documents whose signatures are computed at once by FindNearDuplicates
+const size_t NEAR_DUPLICATE_CHUNK_SIZE = 4096;
+
+// Ids of the documents made of the same words as a document with a smaller id, in ascending order.
+// Compares the fingerprints kept by the server: O(N log N), 16 bytes per document.
+// Documents with equal fingerprints are confirmed on their sets of words before being reported.
+template <typename ExecutionPolicy>
+std::vector<int> FindDuplicates(ExecutionPolicy&&, const SearchServer&);
+std::vector<int> FindDuplicates(const SearchServer&);
+
+// Ids of the documents whose set of words has a Jaccard similarity of at least similarity with
+// the set of an earlier kept document, in ascending order. Candidate pairs come from MinHash
+// signatures split into LSH bands and are checked exactly, so rare pairs close to the threshold
+// can be missed but no pair below it is reported. Memory is spent only on the band keys of the
+// kept documents. Throws std::invalid_argument unless 0 < similarity <= 1.
+template <typename ExecutionPolicy>
+std::vector<int> FindNearDuplicates(ExecutionPolicy&&, const SearchServer&, double similarity);
+std::vector<int> FindNearDuplicates(const SearchServer&, double similarity);
+
+void RemoveDuplicates(SearchServer&);
+void RemoveNearDuplicates(SearchServer&, double similarity);
+
+// Minimums of MIN_HASH_SIZE independent hashes over the terms
+std::vector<uint64_t> ComputeMinHash(const std::vector<TermId>& terms);
+
+// |A & B| / |A | B| of two sorted sets, 1 for two empty sets
+double ComputeJaccardSimilarity(const std::vector<TermId>& lhs, const std::vector<TermId>& rhs);
+
+// Rows per LSH band: the most selective banding that still finds pairs somewhat below similarity
+size_t ComputeBandRows(double similarity);
+
+template <typename ExecutionPolicy>
+std::vector<int> FindDuplicates(ExecutionPolicy&& policy, const SearchServer& search_server) {
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<std::pair<uint64_t, int>> fingerprints(document_ids.size());
+    std::transform(policy, document_ids.begin(), document_ids.end(), fingerprints.begin(), [&search_server](int document_id) {
+        return std::pair{ search_server.GetDocumentFingerprint(document_id), document_id };
+        });
+
+    // Equal fingerprints become adjacent, the smallest id first
+    std::sort(policy, fingerprints.begin(), fingerprints.end());
+    std::vector<int> duplicates;
+    // Term sets of the kept documents in the current run of equal fingerprints.
+    // A hash collision must not delete a distinct document, so a match is confirmed on the terms.
+    std::vector<std::vector<TermId>> kept_terms;
+    for (size_t i = 0; i < fingerprints.size(); ++i) {
+        const bool run_continues = i > 0 && fingerprints[i].first == fingerprints[i - 1].first;
+        const bool run_goes_on = i + 1 < fingerprints.size() && fingerprints[i].first == fingerprints[i + 1].first;
+        if (!run_continues) {
+            kept_terms.clear();
+            if (run_goes_on) {
+                kept_terms.push_back(search_server.GetDocumentTerms(fingerprints[i].second));
+            }
+            continue;
+        }
+        std::vector<TermId> terms = search_server.GetDocumentTerms(fingerprints[i].second);
+        if (std::find(kept_terms.begin(), kept_terms.end(), terms) != kept_terms.end()) {
+            duplicates.push_back(fingerprints[i].second);
+        }
+        else {
+            kept_terms.push_back(std::move(terms));
+        }
+    }
+    std::sort(policy, duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+template <typename ExecutionPolicy>
+std::vector<int> FindNearDuplicates(ExecutionPolicy&& policy, const SearchServer& search_server, double similarity) {
+    using namespace std::string_literals;
+    if (!(similarity > 0 && similarity <= 1)) {
+        throw std::invalid_argument("similarity must be in (0, 1]"s);
+    }
+    const size_t band_rows = ComputeBandRows(similarity);
+    const size_t band_count = MIN_HASH_SIZE / band_rows;
+
+    struct Signature {
+        std::vector<TermId> terms;
+        std::vector<uint64_t> band_keys;
+    };
+    const auto sign = [band_rows, band_count, &search_server](int document_id) {
+        Signature signature{ search_server.GetDocumentTerms(document_id), {} };
+        const std::vector<uint64_t> min_hash = ComputeMinHash(signature.terms);
+        signature.band_keys.reserve(band_count);
+        for (size_t band = 0; band < band_count; ++band) {
+            uint64_t key = band;
+            for (size_t row = 0; row < band_rows; ++row) {
+                key = (key ^ min_hash[band * band_rows + row]) * 1099511628211ull;
+            }
+            signature.band_keys.push_back(key);
+        }
+        return signature;
+    };
+
+    // Kept documents by band, in one map keyed on the band key with the band folded in
+    std::unordered_map<uint64_t, std::vector<int>> bands;
+    std::vector<int> duplicates;
+
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<Signature> chunk;
+    std::vector<int> checked_ids;
+    for (size_t first = 0; first < document_ids.size(); first += NEAR_DUPLICATE_CHUNK_SIZE) {
+        const size_t last = std::min(first + NEAR_DUPLICATE_CHUNK_SIZE, document_ids.size());
+        chunk.resize(last - first);
+        std::transform(policy, document_ids.begin() + first, document_ids.begin() + last, chunk.begin(), sign);
+
+        // Documents are kept in id order, so each one is compared with the smaller kept ids only
+        for (size_t i = first; i < last; ++i) {
+            const Signature& signature = chunk[i - first];
+            bool is_duplicate = false;
+            checked_ids.clear();
+            for (const uint64_t key : signature.band_keys) {
+                const auto it = bands.find(key);
+                if (it == bands.end()) {
+                    continue;
+                }
+                is_duplicate = std::any_of(it->second.begin(), it->second.end(), [&](int kept_id) {
+                    // A pair sharing several bands is checked once
+                    if (std::find(checked_ids.begin(), checked_ids.end(), kept_id) != checked_ids.end()) {
+                        return false;
+                    }
+                    checked_ids.push_back(kept_id);
+                    return ComputeJaccardSimilarity(signature.terms, search_server.GetDocumentTerms(kept_id)) >= similarity;
+                    });
+                if (is_duplicate) {
+                    break;
+                }
+            }
+            if (is_duplicate) {
+                duplicates.push_back(document_ids[i]);
+                continue;
+            }
+            for (const uint64_t key : signature.band_keys) {
+                bands[key].push_back(document_ids[i]);
+            }
+        }
+    }
+    return duplicates;
+}
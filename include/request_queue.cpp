@@ -1,9 +1,30 @@
 #include "request_queue.h"
 
+#include <limits>
+#include <thread>
+
+namespace {
+
+int64_t ToNanoseconds(RequestQueue::Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+} // namespace
+
+RequestQueue::RequestQueue(const SearchServer& search_server, Clock::duration window, size_t capacity)
+    : search_server_(search_server)
+    , window_(window)
+    , capacity_(capacity) {
+    if (capacity_ == 0) {
+        throw std::invalid_argument("request log capacity must be positive");
+    }
+    slots_ = std::make_unique<Slot[]>(capacity_);
+}
+
+// Goes through the status overload of the server, which can answer from its query cache
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-        });
+    const Clock::time_point start = Clock::now();
+    return AddResult(start, search_server_.FindTopDocuments(raw_query, status));
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
@@ -11,11 +32,77 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    int empty_result = 0;
-    for (const QueryResult& r : requests_) {
-        if (r.request.size() == 0) {
-            empty_result++;
+    EvictExpired();
+    return static_cast<int>(no_result_count_.load());
+}
+
+RequestQueue::Stats RequestQueue::GetStats() const {
+    EvictExpired();
+    Stats stats;
+    stats.request_count = request_count_.load();
+    stats.no_result_count = no_result_count_.load();
+    stats.document_count = document_count_.load();
+    stats.latency = std::chrono::nanoseconds(latency_.load());
+    return stats;
+}
+
+std::vector<Document> RequestQueue::AddResult(Clock::time_point start, std::vector<Document> result) {
+    const Clock::time_point now = Clock::now();
+    const uint64_t ticket = head_.fetch_add(1);
+
+    // The slot is free once the request written capacity_ tickets ago is evicted
+    while (tail_.load() + capacity_ <= ticket) {
+        if (!TryEvictOldest(std::numeric_limits<int64_t>::max())) {
+            std::this_thread::yield();
         }
     }
-    return empty_result;
-}
\ No newline at end of file
+
+    // Counted before the slot is published, so an evictor never subtracts first
+    ++request_count_;
+    if (result.empty()) {
+        ++no_result_count_;
+    }
+    document_count_ += result.size();
+    latency_ += ToNanoseconds(now - start);
+
+    Slot& slot = slots_[ticket % capacity_];
+    slot.timestamp.store(ToNanoseconds(now.time_since_epoch()), std::memory_order_relaxed);
+    slot.document_count.store(result.size(), std::memory_order_relaxed);
+    slot.latency.store(ToNanoseconds(now - start), std::memory_order_relaxed);
+    slot.sequence.store(ticket + 1, std::memory_order_release);
+
+    EvictExpired();
+    return result;
+}
+
+bool RequestQueue::TryEvictOldest(int64_t min_timestamp) const {
+    uint64_t oldest = tail_.load();
+    const Slot& slot = slots_[oldest % capacity_];
+    if (slot.sequence.load(std::memory_order_acquire) != oldest + 1) {
+        return false;
+    }
+    const int64_t timestamp = slot.timestamp.load(std::memory_order_relaxed);
+    const uint64_t document_count = slot.document_count.load(std::memory_order_relaxed);
+    const int64_t latency = slot.latency.load(std::memory_order_relaxed);
+    if (timestamp >= min_timestamp) {
+        return false;
+    }
+    // The slot can't be reused before tail_ moves past oldest, so if this succeeds the
+    // fields read above belong to the evicted request
+    if (!tail_.compare_exchange_strong(oldest, oldest + 1)) {
+        return true;
+    }
+    --request_count_;
+    if (document_count == 0) {
+        --no_result_count_;
+    }
+    document_count_ -= document_count;
+    latency_ -= latency;
+    return true;
+}
+
+void RequestQueue::EvictExpired() const {
+    const int64_t min_timestamp = ToNanoseconds((Clock::now() - window_).time_since_epoch());
+    while (TryEvictOldest(min_timestamp)) {
+    }
+}
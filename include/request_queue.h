@@ -1,23 +1,37 @@
 #pragma once
 
-#include <deque>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 
 #include "search_server.h"
 
+// Requests kept by default: one a minute for a day
+const size_t REQUEST_LOG_CAPACITY = 1440;
+
+// Runs requests against a server and keeps statistics over the recent ones: those made
+// within the time window, and at most capacity of them. Only a few numbers per request are
+// stored, in a ring buffer, and the statistics are updated as requests enter and leave it.
+// AddFindRequest can be called from many threads at once, the log takes no locks.
 class RequestQueue {
+public:
+    using Clock = std::chrono::steady_clock;
 
-    struct QueryResult {
-        std::vector<Document> request;
+    // Totals over the requests in the log
+    struct Stats {
+        size_t request_count = 0;
+        size_t no_result_count = 0;
+        size_t document_count = 0;
+        std::chrono::nanoseconds latency{ 0 };
     };
 
-    const SearchServer& search_server_;
-
-    std::deque<QueryResult> requests_;
+    explicit RequestQueue(const SearchServer& search_server,
+        Clock::duration window = std::chrono::hours(24),
+        size_t capacity = REQUEST_LOG_CAPACITY);
 
-    const static int sec_in_day_ = 1440;
-
-public:
-    explicit RequestQueue(const SearchServer& search_server) :search_server_(search_server) {}
+    RequestQueue(const RequestQueue&) = delete;
+    RequestQueue& operator=(const RequestQueue&) = delete;
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string&, DocumentPredicate);
@@ -26,16 +40,44 @@ public:
 
     std::vector<Document> AddFindRequest(const std::string&);
 
+    // O(1) amortized: requests that left the window are evicted first
     int GetNoResultRequests() const;
+    Stats GetStats() const;
+
+private:
+    // sequence is the ticket of the request written last plus one, the other fields
+    // are valid once it is set
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence = 0;
+        std::atomic<int64_t> timestamp = 0;
+        std::atomic<uint64_t> document_count = 0;
+        std::atomic<int64_t> latency = 0;
+    };
+
+    const SearchServer& search_server_;
+    const Clock::duration window_;
+    const size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+
+    // Requests [tail_, head_) are in the log. head_ is taken by writers before they fill
+    // their slot, tail_ is advanced by whoever evicts, each request is evicted once.
+    alignas(64) std::atomic<uint64_t> head_ = 0;
+    alignas(64) mutable std::atomic<uint64_t> tail_ = 0;
+
+    alignas(64) mutable std::atomic<uint64_t> request_count_ = 0;
+    mutable std::atomic<uint64_t> no_result_count_ = 0;
+    mutable std::atomic<uint64_t> document_count_ = 0;
+    mutable std::atomic<int64_t> latency_ = 0;
+
+    std::vector<Document> AddResult(Clock::time_point start, std::vector<Document>);
+
+    // false if the log is empty or its oldest request is still being written
+    bool TryEvictOldest(int64_t min_timestamp) const;
+    void EvictExpired() const;
 };
 
 template <typename DocumentPredicate>
-std::vector<Document>RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-    if (requests_.size() >= sec_in_day_) {
-        requests_.pop_front();
-    }
-
-    //fill queue by all requests
-    requests_.push_back({ search_server_.FindTopDocuments(raw_query, document_predicate) });
-    return requests_.back().request;
-}
\ No newline at end of file
+std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    const Clock::time_point start = Clock::now();
+    return AddResult(start, search_server_.FindTopDocuments(raw_query, document_predicate));
+}
@@ -0,0 +1,22 @@
+#include "score_accumulator.h"
+
+void ScoreAccumulator::Reset(int begin_slot, size_t slot_count) {
+    // Left over when a predicate threw in the middle of a query
+    for (const uint32_t index : touched_) {
+        scores_[index] = 0;
+        is_touched_[index] = false;
+    }
+    touched_.clear();
+
+    if (scores_.size() < slot_count) {
+        scores_.resize(slot_count, 0);
+        is_touched_.resize(slot_count, false);
+    }
+    begin_slot_ = begin_slot;
+    slot_count_ = slot_count;
+}
+
+ScoreAccumulator& ScoreAccumulator::GetThreadLocal() {
+    thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
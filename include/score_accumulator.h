@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Dense relevance accumulator over a range of document slots, filled term at a time.
+// Scores live in an array indexed by slot and touched slots are listed, so adding is one store
+// and reading back and clearing cost O(touched) rather than a tree insert per posting.
+class ScoreAccumulator {
+public:
+    // Starts accumulating over slots [begin_slot, begin_slot + slot_count), all scores zero
+    void Reset(int begin_slot, size_t slot_count);
+
+    inline void Add(int slot, double score) {
+        const uint32_t index = static_cast<uint32_t>(slot - begin_slot_);
+        if (!is_touched_[index]) {
+            is_touched_[index] = true;
+            touched_.push_back(index);
+        }
+        scores_[index] += score;
+    }
+
+    inline size_t GetTouchedCount() const noexcept {
+        return touched_.size();
+    }
+
+    // Calls handler(slot, score) for every touched slot in ascending order and clears them
+    template <typename Handler>
+    void ForEachScore(Handler handler);
+
+    // Scratch accumulator of the calling thread, kept at the largest range it has seen.
+    // A thread must finish one query with it before starting another.
+    static ScoreAccumulator& GetThreadLocal();
+
+private:
+    int begin_slot_ = 0;
+    size_t slot_count_ = 0;
+    std::vector<double> scores_;
+    std::vector<uint8_t> is_touched_;
+    std::vector<uint32_t> touched_;
+};
+
+template <typename Handler>
+void ScoreAccumulator::ForEachScore(Handler handler) {
+    const auto report = [this, &handler](uint32_t index) {
+        const double score = scores_[index];
+        scores_[index] = 0;
+        is_touched_[index] = false;
+        handler(begin_slot_ + static_cast<int>(index), score);
+    };
+    // Sorting the touched list beats scanning the range only while few slots are touched
+    if (touched_.size() * 16 < slot_count_) {
+        std::sort(touched_.begin(), touched_.end());
+        for (const uint32_t index : touched_) {
+            report(index);
+        }
+    }
+    else {
+        for (uint32_t index = 0; index < slot_count_; ++index) {
+            if (is_touched_[index]) {
+                report(index);
+            }
+        }
+    }
+    touched_.clear();
+}
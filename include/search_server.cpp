@@ -1,5 +1,24 @@
 #include "search_server.h"
 
+SearchServerMetrics& SearchServerMetrics::Get() {
+    static SearchServerMetrics metrics = [] {
+        MetricsRegistry& registry = MetricsRegistry::GetDefault();
+        return SearchServerMetrics{
+            registry.GetHistogram("search.parse"),
+            registry.GetHistogram("search.idf"),
+            registry.GetHistogram("search.score"),
+            registry.GetHistogram("search.materialize"),
+            registry.GetHistogram("search.top_k"),
+            registry.GetHistogram("search.rank"),
+            registry.GetHistogram("search.match_document"),
+            registry.GetCounter("search.queries"),
+            registry.GetCounter("search.documents_added"),
+            registry.GetCounter("search.documents_removed"),
+        };
+    }();
+    return metrics;
+}
+
 SearchServer::SearchServer(const std::string_view& stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {}
 
 SearchServer::SearchServer(const std::string& stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {}
@@ -7,63 +26,279 @@ SearchServer::SearchServer(const std::string& stop_words_text) : SearchServer(Sp
 void SearchServer::AddDocument(int document_id, const std::string_view& document, DocumentStatus status,
     const std::vector<int>& ratings) {
 
-    if ((document_id < 0)) {
-        throw std::invalid_argument("ID can't be less than zero"s);
-    }
-    if (documents_.count(document_id) > 0) {
-        throw std::invalid_argument("ID already exists"s);
-    }
-
-    std::vector<std::string> words = SplitIntoWordsNoStop(document);
-
-    const double inv_word_count = 1.0 / words.size();
-    for (const std::string& word : words) {
-        doc_to_word_freqs_[document_id][word] += inv_word_count;
-        word_to_doc_freqs_[word][document_id] += inv_word_count;
-    }
-
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
-    document_id_.emplace(document_id);
+    CheckWritable();
+    InstallMerge(false);
+    CheckNewDocumentId(document_id);
+
+    const DocumentWordFreqs document_word_freqs = ComputeWordFreqs(document);
+    std::vector<WordFreq> word_freqs = InternWordFreqs(document_word_freqs.word_freqs);
+    IndexDocumentStats(word_freqs, document_word_freqs.length);
+    open_segment_.AddDocument(std::move(word_freqs));
+
+    document_to_slot_.emplace(document_id, static_cast<int>(slot_document_ids_.size()));
+    slot_document_ids_.push_back(document_id);
+    slot_ratings_.push_back(ComputeAverageRating(ratings));
+    slot_statuses_.push_back(status);
+    ++generation_;
+    SEARCH_COUNTER_ADD(documents_added, 1);
+    SealOpenSegment();
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const {
-
-    return FindTopDocuments(
-        raw_query,
-        [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+    return FindTopDocuments(std::execution::seq, raw_query, status);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+PreparedQuery SearchServer::PrepareQuery(const std::string_view& raw_query) const {
+    return ParseQuery(raw_query);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentStatus status) const {
+    return FindTopDocuments(std::execution::seq, query, status);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query) const {
+    return FindTopDocuments(query, DocumentStatus::ACTUAL);
+}
+
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view& raw_query, int document_id) const {
     return MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(const int document_id) const noexcept {
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const PreparedQuery& query, int document_id) const {
+    return MatchDocument(std::execution::seq, query, document_id);
+}
 
-    auto it = doc_to_word_freqs_.find(document_id);
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(const PreparedQuery& query, const std::vector<int>& document_ids) const {
+    return MatchDocuments(std::execution::seq, query, document_ids);
+}
 
-    std::map<std::string_view, double>* result = new std::map<std::string_view, double>;
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(const std::string_view& raw_query, const std::vector<int>& document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+std::map<std::string_view, double> SearchServer::GetWordFrequencies(const int document_id) const {
+
+    const int slot = FindSlot(document_id);
 
-    if (it != doc_to_word_freqs_.end()) {
-        result->insert(it->second.begin(), it->second.end());
-        /*
-        for (auto& [word, freq] : it->second) {
-            result.emplace(std::string_view(word), freq);
+    std::map<std::string_view, double> result;
+
+    if (slot >= 0) {
+        for (const auto [term_id, freq] : GetWordFreqs(slot)) {
+            result.emplace_hint(result.end(), GetTerm(term_id), freq);
         }
-        */
     }
-    return *result;
+    return result;
+}
+
+uint64_t SearchServer::GetDocumentFingerprint(int document_id) const {
+    const int slot = FindSlot(document_id);
+    if (slot < 0) {
+        throw std::out_of_range("document not found"s);
+    }
+    return mapped_index_ ? ComputeFingerprint(GetWordFreqs(slot)) : slot_fingerprints_[slot];
+}
+
+std::vector<TermId> SearchServer::GetDocumentTerms(int document_id) const {
+    const int slot = FindSlot(document_id);
+    if (slot < 0) {
+        throw std::out_of_range("document not found"s);
+    }
+    std::vector<TermId> result;
+    const ArrayView<WordFreq> word_freqs = GetWordFreqs(slot);
+    result.reserve(word_freqs.size());
+    for (const WordFreq& word_freq : word_freqs) {
+        result.push_back(word_freq.term_id);
+    }
+    return result;
 }
 
 void SearchServer::RemoveDocument(const int document_id) {
     RemoveDocument(std::execution::seq, document_id);
 }
 
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    RemoveDocuments(std::execution::seq, document_ids);
+}
+
+void SearchServer::WaitForMerges() {
+    if (is_replaying_) {
+        return;
+    }
+    while (pending_merge_.result.valid()) {
+        InstallMerge(true);
+    }
+}
+
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    // The snapshot holds all segments merged into one, live documents renumbered into dense slots
+    const std::vector<int> new_slots = ComputeCompactSlots();
+    const IndexSegment index = MergeLiveDocuments(new_slots);
+
+    SnapshotWriter writer(path);
+
+    writer.WriteStrings(stop_words_);
+    writer.Write(max_result_document_count_);
+
+    // Dictionary in id order, plus the ids ordered by word for lookups in a mapped snapshot
+    const size_t term_count = GetTermCount();
+    std::vector<std::string_view> terms(term_count);
+    std::vector<TermId> sorted_term_ids(term_count);
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        terms[term_id] = GetTerm(term_id);
+        sorted_term_ids[term_id] = term_id;
+    }
+    std::sort(sorted_term_ids.begin(), sorted_term_ids.end(), [&terms](TermId lhs, TermId rhs) {
+        return terms[lhs] < terms[rhs];
+        });
+    writer.WriteStrings(terms);
+    writer.WriteArray(sorted_term_ids);
+
+    // Document table of the live documents only
+    const size_t slot_count = index.GetSlotCount();
+    const DocumentTable table = GetDocumentTable();
+    std::vector<int> document_ids;
+    std::vector<int> ratings;
+    std::vector<DocumentStatus> statuses;
+    std::vector<uint32_t> lengths;
+    for (size_t slot = 0; slot < new_slots.size(); ++slot) {
+        if (new_slots[slot] >= 0) {
+            document_ids.push_back(table.document_ids[slot]);
+            ratings.push_back(table.ratings[slot]);
+            statuses.push_back(table.statuses[slot]);
+            lengths.push_back(table.lengths[slot]);
+        }
+    }
+    std::vector<DocumentSlot> documents;
+    documents.reserve(GetDocumentCount());
+    for (const int document_id : *this) {
+        documents.push_back({ document_id, new_slots[FindSlot(document_id)] });
+    }
+    writer.WriteArray(document_ids);
+    writer.WriteArray(ratings);
+    writer.WriteArray(statuses);
+    writer.WriteArray(lengths);
+    writer.Write(total_document_length_);
+    writer.WriteArray(documents);
+
+    std::vector<uint64_t> forward_offsets = { 0 };
+    std::vector<WordFreq> forward_entries;
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        const ArrayView<WordFreq> word_freqs = index.GetWordFreqs(static_cast<int>(slot));
+        forward_entries.insert(forward_entries.end(), word_freqs.begin(), word_freqs.end());
+        forward_offsets.push_back(forward_entries.size());
+    }
+    writer.WriteArray(forward_offsets);
+    writer.WriteArray(forward_entries);
+
+    // Posting lists concatenated per array, skip offsets stay relative to their list
+    std::vector<uint64_t> byte_offsets = { 0 };
+    std::vector<uint8_t> bytes;
+    std::vector<uint64_t> offsets = { 0 };
+    std::vector<float> freqs;
+    std::vector<uint64_t> skip_offsets = { 0 };
+    std::vector<PostingSkip> skips;
+    std::vector<float> max_term_freqs;
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        const PostingListView postings = index.GetPostings(term_id);
+        bytes.insert(bytes.end(), postings.GetDocumentDeltas(), postings.GetDocumentDeltas() + postings.GetDocumentDeltasSize());
+        byte_offsets.push_back(bytes.size());
+        freqs.insert(freqs.end(), postings.GetTermFreqs(), postings.GetTermFreqs() + postings.size());
+        offsets.push_back(freqs.size());
+        skips.insert(skips.end(), postings.GetSkips(), postings.GetSkips() + postings.GetSkipCount());
+        skip_offsets.push_back(skips.size());
+        max_term_freqs.push_back(static_cast<float>(postings.GetMaxTermFreq()));
+    }
+    writer.WriteArray(byte_offsets);
+    writer.WriteArray(bytes);
+    writer.WriteArray(offsets);
+    writer.WriteArray(freqs);
+    writer.WriteArray(skip_offsets);
+    writer.WriteArray(skips);
+    writer.WriteArray(max_term_freqs);
+    writer.WriteArray(term_max_counts_);
+    writer.WriteArray(term_min_lengths_);
+
+    writer.Finish();
+}
+
+SearchServer SearchServer::LoadSnapshot(const std::string& path) {
+    const MappedIndex index(path);
+    SearchServer server;
+
+    const std::vector<std::string>& stop_words = index.GetStopWords();
+    server.stop_words_.insert(stop_words.begin(), stop_words.end());
+    server.max_result_document_count_ = index.GetMaxResultDocumentCount();
+
+    for (TermId term_id = 0; term_id < index.GetTermCount(); ++term_id) {
+        if (server.terms_.Intern(index.GetTerm(term_id)) != term_id) {
+            throw std::runtime_error("snapshot has a corrupted term dictionary");
+        }
+    }
+
+    const size_t slot_count = index.GetSlotCount();
+    server.slot_document_ids_.assign(index.GetSlotDocumentIds(), index.GetSlotDocumentIds() + slot_count);
+    server.slot_ratings_.assign(index.GetSlotRatings(), index.GetSlotRatings() + slot_count);
+    server.slot_statuses_.assign(index.GetSlotStatuses(), index.GetSlotStatuses() + slot_count);
+    server.slot_lengths_.assign(index.GetSlotLengths(), index.GetSlotLengths() + slot_count);
+    server.total_document_length_ = index.GetTotalDocumentLength();
+    for (const auto [document_id, slot] : index.GetDocuments()) {
+        server.document_to_slot_.emplace_hint(server.document_to_slot_.end(), document_id, slot);
+    }
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        server.slot_fingerprints_.push_back(ComputeFingerprint(index.GetWordFreqs(static_cast<int>(slot))));
+    }
+
+    // A snapshot has no deleted postings, so list sizes are the document frequencies
+    for (TermId term_id = 0; term_id < index.GetTermCount(); ++term_id) {
+        server.document_freqs_.push_back(static_cast<int>(index.GetPostings(term_id).size()));
+    }
+    server.term_max_counts_.assign(index.GetTermMaxCounts().begin(), index.GetTermMaxCounts().end());
+    server.term_min_lengths_.assign(index.GetTermMinLengths().begin(), index.GetTermMinLengths().end());
+    if (slot_count > 0) {
+        server.sealed_segments_.push_back({ std::make_shared<const IndexSegment>(index), std::vector<bool>(slot_count) });
+    }
+    server.open_segment_ = IndexSegment(static_cast<int>(slot_count));
+    return server;
+}
+
+SearchServer SearchServer::MapSnapshot(const std::string& path, bool verify_checksum) {
+    SearchServer server;
+    server.mapped_index_ = std::make_shared<const MappedIndex>(path, verify_checksum);
+
+    const std::vector<std::string>& stop_words = server.mapped_index_->GetStopWords();
+    server.stop_words_.insert(stop_words.begin(), stop_words.end());
+    server.max_result_document_count_ = server.mapped_index_->GetMaxResultDocumentCount();
+
+    const MappedIndex& index = *server.mapped_index_;
+    for (TermId term_id = 0; term_id < index.GetTermCount(); ++term_id) {
+        server.document_freqs_.push_back(static_cast<int>(index.GetPostings(term_id).size()));
+    }
+    server.total_document_length_ = index.GetTotalDocumentLength();
+    server.term_max_counts_.assign(index.GetTermMaxCounts().begin(), index.GetTermMaxCounts().end());
+    server.term_min_lengths_.assign(index.GetTermMinLengths().begin(), index.GetTermMinLengths().end());
+    server.sealed_segments_.push_back({ std::make_shared<const IndexSegment>(server.mapped_index_), std::vector<bool>(index.GetSlotCount()) });
+    server.open_segment_ = IndexSegment(static_cast<int>(index.GetSlotCount()));
+    return server;
+}
+
+// Sum of a strong mix of every term id: commutative, so the word order doesn't matter,
+// and term ids of a document are unique, so repeats don't either
+uint64_t SearchServer::ComputeFingerprint(ArrayView<WordFreq> word_freqs) {
+    uint64_t fingerprint = 0;
+    for (const WordFreq& word_freq : word_freqs) {
+        // splitmix64 finalizer
+        uint64_t hash = word_freq.term_id + 0x9e3779b97f4a7c15ull;
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+        fingerprint += hash ^ (hash >> 31);
+    }
+    return fingerprint;
+}
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
@@ -75,31 +310,282 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string_view& text) const {
-    std::vector<std::string> result;
+void SearchServer::CheckNewDocumentId(int document_id) const {
+    if ((document_id < 0)) {
+        throw std::invalid_argument("ID can't be less than zero"s);
+    }
+    if (document_to_slot_.count(document_id) > 0) {
+        throw std::invalid_argument("ID already exists"s);
+    }
+}
+
+void SearchServer::CheckWritable() const {
+    if (mapped_index_) {
+        throw std::logic_error("the server serves a mapped snapshot and is read-only"s);
+    }
+}
+
+SearchServer::DocumentWordFreqs SearchServer::ComputeWordFreqs(const std::string_view& text) const {
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(text);
+
+    DocumentWordFreqs result;
+    result.length = static_cast<uint32_t>(words.size());
+    const double inv_word_count = 1.0 / words.size();
+    for (const std::string_view word : words) {
+        result.word_freqs[word] += inv_word_count;
+    }
+    return result;
+}
+
+void SearchServer::IndexDocumentStats(const std::vector<WordFreq>& word_freqs, uint32_t length) {
+    const size_t term_count = terms_.GetTermCount();
+    document_freqs_.resize(term_count);
+    term_max_counts_.resize(term_count, 0);
+    term_min_lengths_.resize(term_count, std::numeric_limits<uint32_t>::max());
+    for (const WordFreq& word_freq : word_freqs) {
+        ++document_freqs_[word_freq.term_id];
+        const uint32_t count = static_cast<uint32_t>(std::lround(word_freq.term_freq * length));
+        term_max_counts_[word_freq.term_id] = std::max(term_max_counts_[word_freq.term_id], count);
+        term_min_lengths_[word_freq.term_id] = std::min(term_min_lengths_[word_freq.term_id], length);
+    }
+    slot_fingerprints_.push_back(ComputeFingerprint(word_freqs));
+    slot_lengths_.push_back(length);
+    total_document_length_ += length;
+}
+
+const SearchServer::SealedSegment* SearchServer::FindSealedSegment(int slot) const {
+    if (slot >= open_segment_.GetBeginSlot()) {
+        return nullptr;
+    }
+    // Last segment beginning at or before the slot
+    return &*(std::upper_bound(sealed_segments_.begin(), sealed_segments_.end(), slot, [](int value, const SealedSegment& segment) {
+        return value < segment.index->GetBeginSlot();
+        }) - 1);
+}
+
+ArrayView<WordFreq> SearchServer::GetWordFreqs(int slot) const {
+    const SealedSegment* segment = FindSealedSegment(slot);
+    return segment ? segment->index->GetWordFreqs(slot) : open_segment_.GetWordFreqs(slot);
+}
+
+bool SearchServer::MarkDeleted(int slot) {
+    for (const WordFreq& word_freq : GetWordFreqs(slot)) {
+        --document_freqs_[word_freq.term_id];
+    }
+    total_document_length_ -= slot_lengths_[slot];
+    const SealedSegment* segment = FindSealedSegment(slot);
+    if (segment == nullptr) {
+        return false;
+    }
+    sealed_segments_[segment - sealed_segments_.data()].deleted[slot - segment->index->GetBeginSlot()] = true;
+    return true;
+}
+
+void SearchServer::SealOpenSegment() {
+    const size_t slot_count = open_segment_.GetSlotCount();
+    if (slot_count < segment_document_limit_ || is_replaying_) {
+        return;
+    }
+    const int end_slot = open_segment_.GetEndSlot();
+    open_segment_.Seal();
+    sealed_segments_.push_back({ std::make_shared<const IndexSegment>(std::move(open_segment_)), std::vector<bool>(slot_count) });
+    open_segment_ = IndexSegment(end_slot);
+    ScheduleMerge();
+}
+
+std::vector<int> SearchServer::ComputeCompactSlots() const {
+    std::vector<int> new_slots(GetSlotCount(), -1);
+    for (const int document_id : *this) {
+        new_slots[FindSlot(document_id)] = 0;
+    }
+    int next_slot = 0;
+    for (int& slot : new_slots) {
+        if (slot == 0) {
+            slot = next_slot++;
+        }
+    }
+    return new_slots;
+}
 
-    for (const std::string& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            return {};
+IndexSegment SearchServer::MergeLiveDocuments(const std::vector<int>& new_slots) const {
+    // Documents removed in place from the open segment are left out as well as tombstoned ones
+    std::vector<const IndexSegment*> segments;
+    std::vector<std::vector<bool>> deleted;
+    ForEachSegment([&segments, &deleted, &new_slots](const IndexSegment& segment, const std::vector<bool>&) {
+        segments.push_back(&segment);
+        std::vector<bool>& segment_deleted = deleted.emplace_back(segment.GetSlotCount());
+        for (int slot = segment.GetBeginSlot(); slot < segment.GetEndSlot(); ++slot) {
+            segment_deleted[slot - segment.GetBeginSlot()] = new_slots[slot] < 0;
         }
-        if (!IsStopWord(word)) {
+        });
+    return IndexSegment::Merge(segments, deleted, true);
+}
+
+void SearchServer::CompactSlots() {
+    const size_t live_count = document_to_slot_.size();
+    const size_t removed_count = slot_document_ids_.size() - live_count;
+    if (removed_count <= live_count || removed_count < segment_document_limit_) {
+        return;
+    }
+
+    // The rebuild supersedes a running merge, dropping it waits for the task
+    pending_merge_ = PendingMerge();
+    const std::vector<int> new_slots = ComputeCompactSlots();
+    IndexSegment index = MergeLiveDocuments(new_slots);
+
+    // Slots only move down, so the tables are compacted in place
+    for (size_t slot = 0; slot < new_slots.size(); ++slot) {
+        if (new_slots[slot] < 0) {
+            continue;
+        }
+        const size_t new_slot = new_slots[slot];
+        slot_document_ids_[new_slot] = slot_document_ids_[slot];
+        slot_ratings_[new_slot] = slot_ratings_[slot];
+        slot_statuses_[new_slot] = slot_statuses_[slot];
+        slot_lengths_[new_slot] = slot_lengths_[slot];
+        slot_fingerprints_[new_slot] = slot_fingerprints_[slot];
+    }
+    slot_document_ids_.resize(live_count);
+    slot_document_ids_.shrink_to_fit();
+    slot_ratings_.resize(live_count);
+    slot_ratings_.shrink_to_fit();
+    slot_statuses_.resize(live_count);
+    slot_statuses_.shrink_to_fit();
+    slot_lengths_.resize(live_count);
+    slot_lengths_.shrink_to_fit();
+    slot_fingerprints_.resize(live_count);
+    slot_fingerprints_.shrink_to_fit();
+    for (auto& [_, slot] : document_to_slot_) {
+        slot = new_slots[slot];
+    }
+
+    sealed_segments_.clear();
+    if (live_count > 0) {
+        sealed_segments_.push_back({ std::make_shared<const IndexSegment>(std::move(index)), std::vector<bool>(live_count) });
+    }
+    open_segment_ = IndexSegment(static_cast<int>(live_count));
+}
+
+void SearchServer::ScheduleMerge() {
+    if (pending_merge_.result.valid() || is_replaying_) {
+        return;
+    }
+
+    // Tier 0 holds segments of less than limit * factor slots, tier 1 less than limit * factor^2, ...
+    const auto get_tier = [this](const SealedSegment& segment) {
+        size_t tier = 0;
+        for (size_t size = segment.index->GetSlotCount() / segment_document_limit_; size >= SEGMENT_MERGE_FACTOR; size /= SEGMENT_MERGE_FACTOR) {
+            ++tier;
+        }
+        return tier;
+    };
+
+    // Newer segments are smaller, so equal tiers are looked for from the end
+    for (size_t end = sealed_segments_.size(); end >= SEGMENT_MERGE_FACTOR; --end) {
+        const size_t first = end - SEGMENT_MERGE_FACTOR;
+        const size_t tier = get_tier(sealed_segments_[first]);
+        if (!std::all_of(sealed_segments_.begin() + first + 1, sealed_segments_.begin() + end, [&get_tier, tier](const SealedSegment& segment) {
+            return get_tier(segment) == tier;
+            })) {
+            continue;
+        }
+
+        // The task owns references to the segments and a copy of their tombstones,
+        // so the server goes on changing while it runs
+        std::vector<std::shared_ptr<const IndexSegment>> sources;
+        std::vector<std::vector<bool>> deleted;
+        for (size_t i = first; i < end; ++i) {
+            sources.push_back(sealed_segments_[i].index);
+            deleted.push_back(sealed_segments_[i].deleted);
+        }
+        pending_merge_.first = first;
+        pending_merge_.count = SEGMENT_MERGE_FACTOR;
+        pending_merge_.result = std::async(std::launch::async, [sources = std::move(sources), deleted = std::move(deleted)]() {
+            std::vector<const IndexSegment*> segments;
+            for (const std::shared_ptr<const IndexSegment>& source : sources) {
+                segments.push_back(source.get());
+            }
+            return std::make_shared<const IndexSegment>(IndexSegment::Merge(segments, deleted));
+            }).share();
+        return;
+    }
+}
+
+void SearchServer::InstallMerge(bool wait) {
+    if (is_replaying_ || !pending_merge_.result.valid()
+        || (!wait && pending_merge_.result.wait_for(0s) != std::future_status::ready)) {
+        return;
+    }
+
+    SealedSegment merged = { pending_merge_.result.get(), {} };
+    const auto first = sealed_segments_.begin() + pending_merge_.first;
+    const auto last = first + pending_merge_.count;
+    // Slots are kept by the merge, so documents removed while it ran keep their tombstones
+    for (auto it = first; it != last; ++it) {
+        merged.deleted.insert(merged.deleted.end(), it->deleted.begin(), it->deleted.end());
+    }
+    *first = std::move(merged);
+    sealed_segments_.erase(first + 1, last);
+
+    pending_merge_ = PendingMerge();
+    ScheduleMerge();
+}
+
+void SearchServer::AdoptSegments(const SearchServer& source) {
+    pending_merge_ = source.pending_merge_;
+    const bool is_same_layout = open_segment_.GetBeginSlot() == source.open_segment_.GetBeginSlot()
+        && open_segment_.GetEndSlot() == source.open_segment_.GetEndSlot()
+        && std::equal(sealed_segments_.begin(), sealed_segments_.end(), source.sealed_segments_.begin(), source.sealed_segments_.end(),
+            [](const SealedSegment& lhs, const SealedSegment& rhs) {
+                return lhs.index == rhs.index;
+            });
+    if (is_same_layout) {
+        return;
+    }
+    sealed_segments_ = source.sealed_segments_;
+    open_segment_ = source.open_segment_;
+}
+
+std::vector<WordFreq> SearchServer::InternWordFreqs(const std::map<std::string_view, double>& word_freqs) {
+    std::vector<WordFreq> result;
+    result.reserve(word_freqs.size());
+    for (const auto [word, term_freq] : word_freqs) {
+        result.push_back({ terms_.Intern(word), static_cast<float>(term_freq) });
+    }
+    std::sort(result.begin(), result.end(), [](const WordFreq& lhs, const WordFreq& rhs) {
+        return lhs.term_id < rhs.term_id;
+        });
+    return result;
+}
+
+std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view& text) const {
+    std::vector<std::string_view> result;
+    bool is_valid_text = true;
+
+    ForEachWord(text, [this, &result, &is_valid_text](std::string_view word, bool is_valid) {
+        is_valid_text = is_valid_text && is_valid;
+        if (is_valid_text && !IsStopWord(word)) {
             result.push_back(word);
         }
+        });
+
+    if (!is_valid_text) {
+        return {};
     }
     return result;
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text, bool is_valid) const {
 
-    if (text.empty()) {
+    if (text.empty() || !is_valid) {
         return QueryWord();
     }
     bool is_minus = false;
     if (text[0] == '-') {
         is_minus = true;
-        text = text.substr(1);
+        text.remove_prefix(1);
     }
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    if (text.empty() || text[0] == '-') {
         return QueryWord();
     }
 
@@ -107,60 +593,91 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string text) const {
     return QueryWord{ text, is_minus, IsStopWord(text) };
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view& text) const {
+PreparedQuery SearchServer::ParseQuery(const std::string_view& text) const {
 
-    Query result;
+    PreparedQuery result;
 
-    for (const std::string& word : SplitIntoWords(text)) {
-        QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
+    {
+        SEARCH_STAGE_TIMER(parse);
+        ForEachWord(text, [this, &result](std::string_view word, bool is_valid) {
+            QueryWord query_word = ParseQueryWord(word, is_valid);
+            if (query_word.is_stop) {
+                return;
+            }
+            // Words missing from the index can neither match nor exclude anything,
+            // but a conjunctive query with one matches nothing
+            const TermId term_id = FindTerm(query_word.data);
+            if (term_id == TermDictionary::INVALID_TERM_ID) {
+                result.has_unknown_plus_words_ |= !query_word.is_minus;
+                return;
+            }
             if (query_word.is_minus) {
-                result.minus_words.insert(query_word.data);
+                result.minus_words_.push_back(term_id);
             }
             else {
-                result.plus_words.insert(query_word.data);
+                result.plus_words_.push_back(term_id);
             }
+            });
+
+        for (std::vector<TermId>* words : { &result.plus_words_, &result.minus_words_ }) {
+            std::sort(words->begin(), words->end());
+            words->erase(std::unique(words->begin(), words->end()), words->end());
         }
     }
+    UpdateQuery(result);
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string& word) const {
-    int size = 0;
-
-    for (const auto& [doc, content] : doc_to_word_freqs_) {
-        if (content.count(word)) {
-            size++;
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchSlot(const PreparedQuery& query, int slot) const {
+    SEARCH_STAGE_TIMER(match_document);
+    const ArrayView<WordFreq> word_freqs = GetWordFreqs(slot);
+    const DocumentStatus status = GetDocumentTable().statuses[slot];
+    std::vector<std::string_view> matched_words;
+
+    // Calls handler for every query word in the document, until it returns false.
+    // Words are unique on both sides, so no word is reported twice.
+    const auto for_each_common = [&word_freqs](const std::vector<TermId>& term_ids, auto handler) {
+        auto term = term_ids.begin();
+        const WordFreq* word = word_freqs.begin();
+        while (term != term_ids.end() && word != word_freqs.end()) {
+            if (*term < word->term_id) {
+                ++term;
+            }
+            else if (word->term_id < *term) {
+                ++word;
+            }
+            else if (!handler(*term++)) {
+                return;
+            }
+            else {
+                ++word;
+            }
         }
+    };
+
+    bool has_minus_words = false;
+    for_each_common(query.minus_words_, [&has_minus_words](TermId) {
+        has_minus_words = true;
+        return false;
+        });
+    if (has_minus_words) {
+        return { matched_words, status };
     }
 
-    return log(GetDocumentCount() * 1.0 / size);
+    for_each_common(query.plus_words_, [this, &matched_words](TermId term_id) {
+        matched_words.push_back(GetTerm(term_id));
+        return true;
+        });
+    std::sort(matched_words.begin(), matched_words.end());
+    return { matched_words, status };
 }
 
-void RemoveDuplicates(SearchServer& search_server) {
-
-    std::set<int> duplicates;
-    std::map<std::set<std::string_view>, int> temp;
-
-    for (const int id : search_server) {
-        const std::map<std::string_view, double>& doc = search_server.GetWordFrequencies(id);
-        std::set<std::string_view> content;
-
-        std::transform(doc.begin(), doc.end(), std::inserter(content, content.begin()), [](const std::pair<std::string_view, double>& d) {
-            return d.first;
-            });
-
-        if (temp.count(content)) {
-            std::cout << "Found duplicate document id " << id << "\n";
-            duplicates.emplace(id);
-        }
-        else {
-            temp.emplace(content, id);
-        }
-    }
-
-    for (const int id : duplicates) {
-        search_server.RemoveDocument(id);
+void SearchServer::UpdateQuery(PreparedQuery& query) const {
+    SEARCH_STAGE_TIMER(idf);
+    query.inverse_document_freqs_.clear();
+    for (const TermId term_id : query.plus_words_) {
+        // Words of no live document match nothing, the engines skip them
+        query.inverse_document_freqs_.push_back(document_freqs_[term_id] == 0 ? 0 : ComputeWordInverseDocumentFreq(term_id));
     }
+    query.generation_ = generation_;
 }
-
@@ -3,43 +3,185 @@
 #include <cmath>
 #include <math.h>
 #include <set>
+#include <limits>
 #include <map>
 #include <algorithm>
 #include <execution>
 #include <future>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include "document.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "index_segment.h"
+#include "mapped_index.h"
+#include "metrics.h"
+#include "posting_list.h"
+#include "query_cache.h"
+#include "ranking.h"
+#include "score_accumulator.h"
+#include "term_dictionary.h"
 
 using namespace std::literals;
 
+// Default number of documents returned by FindTopDocuments
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
-class SearchServer {
+// Number of documents the open segment takes before it is sealed
+const size_t SEGMENT_DOCUMENT_LIMIT = 4096;
+
+// Number of sealed segments of one size tier merged together
+const size_t SEGMENT_MERGE_FACTOR = 4;
+
+// Query stage latencies and document counters of all servers, registered in
+// MetricsRegistry::GetDefault() under "search.". Minus words are filtered inside the posting
+// scan, so they are part of score. EXHAUSTIVE checks deletion and the predicate in materialize,
+// the other engines in score. EXHAUSTIVE records score and materialize once per index segment.
+struct SearchServerMetrics {
+    LatencyHistogram& parse;
+    LatencyHistogram& idf;
+    LatencyHistogram& score;
+    LatencyHistogram& materialize;
+    LatencyHistogram& top_k;
+    // Whole ranking of a query that missed the cache, parse excluded
+    LatencyHistogram& rank;
+    LatencyHistogram& match_document;
+    Counter& queries;
+    Counter& documents_added;
+    Counter& documents_removed;
+
+    static SearchServerMetrics& Get();
+};
 
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
+// Building with SEARCH_SERVER_METRICS defined records the stages into SearchServerMetrics,
+// without it the timers and counters compile to nothing
+#ifdef SEARCH_SERVER_METRICS
+#define SEARCH_METRICS_CONCAT_INTERNAL(X, Y) X##Y
+#define SEARCH_METRICS_CONCAT(X, Y) SEARCH_METRICS_CONCAT_INTERNAL(X, Y)
+#define SEARCH_STAGE_TIMER(stage) ScopedTimer SEARCH_METRICS_CONCAT(stage_timer_, __LINE__)(SearchServerMetrics::Get().stage)
+#define SEARCH_COUNTER_ADD(counter, value) SearchServerMetrics::Get().counter.Add(value)
+#else
+#define SEARCH_STAGE_TIMER(stage)
+#define SEARCH_COUNTER_ADD(counter, value)
+#endif
+
+// How FindTopDocuments evaluates a query. EXHAUSTIVE and MAX_SCORE return the same documents.
+enum class QueryEngine {
+    // Scores every posting of every plus word, parallelized by the execution policy
+    EXHAUSTIVE,
+    // Document-at-a-time MaxScore: skips documents that can't enter the current top.
+    // Runs on the calling thread whatever the execution policy.
+    MAX_SCORE,
+    // Only documents containing every plus word, found by intersecting the posting lists.
+    // Segments are intersected in parallel under a parallel policy.
+    CONJUNCTIVE,
+};
+
+// Query parsed and resolved against the index by SearchServer::PrepareQuery, so that it can be
+// run many times without tokenizing or allocating. Holds the sorted, deduplicated term ids of the
+// plus and minus words and the inverse document frequencies of the plus words.
+// Belongs to the server that prepared it and to its copies. The frequencies are recomputed if the
+// index has changed since, words that were not in the index at preparation never match.
+class PreparedQuery {
+public:
+    PreparedQuery() = default;
+
+    inline const std::vector<TermId>& GetPlusWords() const noexcept {
+        return plus_words_;
+    }
+
+    inline const std::vector<TermId>& GetMinusWords() const noexcept {
+        return minus_words_;
+    }
+
+private:
+    friend class SearchServer;
+
+    std::vector<TermId> plus_words_;
+    std::vector<TermId> minus_words_;
+    // Indexed like plus_words_
+    std::vector<double> inverse_document_freqs_;
+    bool has_unknown_plus_words_ = false;
+    // Server generation the frequencies were computed at
+    uint64_t generation_ = 0;
+};
+
+class SearchServer {
+    // Replays its writes on the second copy of the index, see ReplayWrite
+    friend class ConcurrentSearchServer;
 
     struct QueryWord {
-        std::string data;
+        std::string_view data;
         bool is_minus;
         bool is_stop;
     };
 
-    struct Query {
-        std::set<std::string> plus_words;
-        std::set<std::string> minus_words;
+    // Per-slot document attributes, either owned or in a mapped snapshot
+    struct DocumentTable {
+        const int* document_ids;
+        const int* ratings;
+        const DocumentStatus* statuses;
+        const uint32_t* lengths;
+    };
+
+    // Immutable segment and the tombstones of its deleted documents, indexed by slot - begin slot
+    struct SealedSegment {
+        std::shared_ptr<const IndexSegment> index;
+        std::vector<bool> deleted;
+    };
+
+    // Merge of the sealed segments [first, first + count) running in the background
+    struct PendingMerge {
+        size_t first = 0;
+        size_t count = 0;
+        std::shared_future<std::shared_ptr<const IndexSegment>> result;
     };
 
-    std::set<std::string> stop_words_;
-    std::map<int, std::map<std::string, double>> doc_to_word_freqs_;
-    std::map<std::string, std::map<int, double>> word_to_doc_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_id_;
+    std::set<std::string, std::less<>> stop_words_;
+    TermDictionary terms_;
+
+    // Documents are addressed internally by dense slots given out in order of addition.
+    // Slots of removed documents are not reused, so posting lists only grow at the tail.
+    // Once they outnumber the live documents the slots are compacted, see CompactSlots.
+    std::map<int, int> document_to_slot_;
+    std::vector<int> slot_document_ids_;
+    std::vector<int> slot_ratings_;
+    std::vector<DocumentStatus> slot_statuses_;
+    // Non-stop words of each document, repeats included
+    std::vector<uint32_t> slot_lengths_;
+    // Empty for a mapped snapshot, fingerprints are then computed on demand
+    std::vector<uint64_t> slot_fingerprints_;
+
+    // Number of live documents containing each word, indexed by TermId. Sealed segments
+    // keep the postings of their deleted documents, so IDF is taken from these counts.
+    std::vector<int> document_freqs_;
+    // Sum of the lengths of the live documents
+    uint64_t total_document_length_ = 0;
+    // Per word, the largest count in a document and the shortest document with it, over every
+    // document ever added. Removals leave them as they are, which keeps them upper bounds.
+    std::vector<uint32_t> term_max_counts_;
+    std::vector<uint32_t> term_min_lengths_;
+
+    // The index is split by slot ranges: sealed segments in slot order, then the open
+    // segment taking new documents. Removing a document from a sealed segment only sets
+    // its tombstone, merges drop the tombstoned postings.
+    std::vector<SealedSegment> sealed_segments_;
+    IndexSegment open_segment_;
+    size_t segment_document_limit_ = SEGMENT_DOCUMENT_LIMIT;
+    PendingMerge pending_merge_;
+    // Set while ReplayWrite repeats a write: sealing and merging are left to the source copy
+    bool is_replaying_ = false;
+
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+
+    // Changed by every write that can change query results, tags the cached results
+    uint64_t generation_ = 0;
+    mutable QueryCache query_cache_;
+
+    // Set by MapSnapshot. The index is then served from the mapping, the members
+    // above except stop_words_ stay empty and the server is read-only.
+    std::shared_ptr<const MappedIndex> mapped_index_;
 
 
 public:
@@ -47,6 +189,71 @@ public:
     // You can refer this constant as SearchServer::INVALID_DOCUMENT_ID
     inline static constexpr int INVALID_DOCUMENT_ID = -1;
 
+    // Iterates over the ids of the documents in ascending order
+    class DocumentIdIterator {
+        friend class SearchServer;
+
+        std::map<int, int>::const_iterator it_;
+        const DocumentSlot* slot_ = nullptr;
+        bool is_mapped_ = false;
+
+        explicit DocumentIdIterator(std::map<int, int>::const_iterator it) : it_(it) {}
+        explicit DocumentIdIterator(const DocumentSlot* slot) : slot_(slot), is_mapped_(true) {}
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        DocumentIdIterator() = default;
+
+        inline reference operator*() const {
+            return is_mapped_ ? slot_->document_id : it_->first;
+        }
+
+        inline DocumentIdIterator& operator++() {
+            if (is_mapped_) {
+                ++slot_;
+            }
+            else {
+                ++it_;
+            }
+            return *this;
+        }
+
+        inline DocumentIdIterator operator++(int) {
+            DocumentIdIterator it = *this;
+            ++*this;
+            return it;
+        }
+
+        inline DocumentIdIterator& operator--() {
+            if (is_mapped_) {
+                --slot_;
+            }
+            else {
+                --it_;
+            }
+            return *this;
+        }
+
+        inline DocumentIdIterator operator--(int) {
+            DocumentIdIterator it = *this;
+            --*this;
+            return it;
+        }
+
+        inline bool operator==(const DocumentIdIterator& other) const {
+            return is_mapped_ ? slot_ == other.slot_ : it_ == other.it_;
+        }
+
+        inline bool operator!=(const DocumentIdIterator& other) const {
+            return !(*this == other);
+        }
+    };
+
     explicit SearchServer() = default;
 
     explicit SearchServer(const std::string_view&);
@@ -60,18 +267,74 @@ public:
 
     void AddDocument(int, const std::string_view&, DocumentStatus, const std::vector<int>&);
 
+    // Adds a batch of documents. Texts are tokenized and posting lists are extended in parallel
+    // under a parallel policy. Throws before changing anything if any id is negative, already
+    // present or repeated within the batch.
+    template <typename ExecutionPolicy, typename DocumentContainer>
+    void AddDocuments(ExecutionPolicy&&, const DocumentContainer&);
+
     inline int GetDocumentCount() const noexcept {
-        return documents_.size();
+        return mapped_index_ ? mapped_index_->GetDocuments().size() : document_to_slot_.size();
+    }
+
+    // Number of documents returned by FindTopDocuments
+    inline size_t GetMaxResultDocumentCount() const noexcept {
+        return max_result_document_count_;
+    }
+
+    inline void SetMaxResultDocumentCount(size_t count) noexcept {
+        max_result_document_count_ = count;
+        ++generation_;
+    }
+
+    // Caches the results of up to capacity queries filtered by status, keyed on their
+    // parsed words, so queries differing only in word order or repeats share an entry.
+    // Adding or removing documents invalidates every entry. Queries with a custom predicate
+    // are never cached. 0, the default, disables the cache and drops its entries.
+    inline void SetQueryCacheCapacity(size_t capacity) {
+        query_cache_ = QueryCache(capacity);
+    }
+
+    inline QueryCache::Stats GetQueryCacheStats() const noexcept {
+        return query_cache_.GetStats();
+    }
+
+    // Number of changes made to the index so far
+    inline uint64_t GetGeneration() const noexcept {
+        return generation_;
+    }
+
+    // The open segment is sealed once it holds this many documents, 4096 by default
+    inline size_t GetSegmentDocumentLimit() const noexcept {
+        return segment_document_limit_;
+    }
+
+    inline void SetSegmentDocumentLimit(size_t limit) noexcept {
+        segment_document_limit_ = std::max<size_t>(limit, 1);
+    }
+
+    // Sealed segments plus the open one
+    inline size_t GetSegmentCount() const noexcept {
+        return sealed_segments_.size() + 1;
+    }
+
+    // Merges run in the background and are picked up by the next AddDocument(s) or
+    // RemoveDocument(s) call. This waits for every merge due and installs it.
+    void WaitForMerges();
+
+    // Servers returned by MapSnapshot can't be changed
+    inline bool IsReadOnly() const noexcept {
+        return mapped_index_ != nullptr;
     }
 
     //O(1)
-    inline std::set<int>::const_iterator begin() const noexcept {
-        return document_id_.begin();
+    inline DocumentIdIterator begin() const noexcept {
+        return mapped_index_ ? DocumentIdIterator(mapped_index_->GetDocuments().begin()) : DocumentIdIterator(document_to_slot_.begin());
     }
 
     //O(1)
-    inline std::set<int>::const_iterator end() const noexcept {
-        return document_id_.end();
+    inline DocumentIdIterator end() const noexcept {
+        return mapped_index_ ? DocumentIdIterator(mapped_index_->GetDocuments().end()) : DocumentIdIterator(document_to_slot_.end());
     }
 
     template <typename DocumentPredicate>
@@ -84,48 +347,289 @@ public:
     
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const std::string_view&, DocumentStatus) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const std::string_view&, DocumentPredicate, QueryEngine) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const std::string_view&, DocumentStatus, QueryEngine) const;
     
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const std::string_view&) const;
 
+    // Parses a query once for the overloads below. Malformed words are not rejected: like words
+    // missing from the index they match nothing, and make a CONJUNCTIVE query match nothing.
+    PreparedQuery PrepareQuery(const std::string_view& raw_query) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery&, DocumentPredicate) const;
+    std::vector<Document> FindTopDocuments(const PreparedQuery&, DocumentStatus) const;
+    std::vector<Document> FindTopDocuments(const PreparedQuery&) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const PreparedQuery&, DocumentPredicate, QueryEngine = QueryEngine::EXHAUSTIVE) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const PreparedQuery&, DocumentStatus, QueryEngine = QueryEngine::EXHAUSTIVE) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const PreparedQuery&) const;
+
+    // Rank with another function than TF-IDF, see ranking.h, for example Bm25Ranking(1.2, 0.75).
+    // These results are not cached.
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Ranking>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const std::string_view&, DocumentPredicate, QueryEngine, const Ranking&) const;
+
+    template <typename ExecutionPolicy, typename Ranking>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const std::string_view&, DocumentStatus, QueryEngine, const Ranking&) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Ranking>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const PreparedQuery&, DocumentPredicate, QueryEngine, const Ranking&) const;
+
+    template <typename ExecutionPolicy, typename Ranking>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, const PreparedQuery&, DocumentStatus, QueryEngine, const Ranking&) const;
+
     template<typename ExecutionPolicy>
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ExecutionPolicy&&, const std::string_view&, int) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view&, int) const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(const int) const noexcept;
+    template<typename ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ExecutionPolicy&&, const PreparedQuery&, int) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const PreparedQuery&, int) const;
+
+    // MatchDocument for every id, results in the order of the ids. The query is parsed once and the
+    // documents are spread over threads by the policy. Throws std::out_of_range before matching
+    // anything if a document is missing.
+    template<typename ExecutionPolicy, typename IdContainer>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(ExecutionPolicy&&, const PreparedQuery&, const IdContainer&) const;
+    template<typename ExecutionPolicy, typename IdContainer>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(ExecutionPolicy&&, const std::string_view&, const IdContainer&) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const PreparedQuery&, const std::vector<int>&) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const std::string_view&, const std::vector<int>&) const;
+
+    std::map<std::string_view, double> GetWordFrequencies(const int) const;
+
+    // Order-independent hash of the set of words of a document: documents made of the same
+    // words in any order and number have the same fingerprint. O(1), kept up by AddDocument(s).
+    // Throws std::out_of_range for an unknown id.
+    uint64_t GetDocumentFingerprint(int document_id) const;
+
+    // Ids of the words of a document in ascending order, comparable within one server.
+    // Throws std::out_of_range for an unknown id.
+    std::vector<TermId> GetDocumentTerms(int document_id) const;
+
+    // Writes the whole index to a versioned, checksummed binary file.
+    // Throws std::runtime_error on I/O errors.
+    void SaveSnapshot(const std::string& path) const;
+
+    // Restores a server saved with SaveSnapshot without tokenizing any text.
+    // Throws std::runtime_error if the file is missing, corrupted or of another version.
+    static SearchServer LoadSnapshot(const std::string& path);
+
+    // Serves a snapshot in place from a read-only memory mapping: startup costs no parsing
+    // and processes mapping the same file share its pages. Copies of the server share the mapping.
+    // Adding or removing documents throws std::logic_error.
+    // Skipping the checksum avoids reading the whole file up front, the structure is still checked.
+    static SearchServer MapSnapshot(const std::string& path, bool verify_checksum = true);
 
     template<typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&&, const int document_id);
     void RemoveDocument(const int document_id);
 
+    // Removes many documents at once. Documents of sealed segments get tombstones, in the open
+    // segment erasures are grouped by word, so every posting list is re-encoded once, and lists
+    // are processed in parallel under a parallel policy. Unknown ids are ignored.
+    template<typename ExecutionPolicy, typename IdContainer>
+    void RemoveDocuments(ExecutionPolicy&&, const IdContainer&);
+    void RemoveDocuments(const std::vector<int>&);
+
 private:
 
     template<typename str>
     static bool IsValidWord(const str&);
 
     static int ComputeAverageRating(const std::vector<int>&);
+    static uint64_t ComputeFingerprint(ArrayView<WordFreq>);
+
+    void CheckNewDocumentId(int) const;
+
+    // Throws std::logic_error for servers returned by MapSnapshot
+    void CheckWritable() const;
+
+    // Term frequencies of the non-stop words of a document text and their number
+    struct DocumentWordFreqs {
+        std::map<std::string_view, double> word_freqs;
+        uint32_t length = 0;
+    };
+
+    DocumentWordFreqs ComputeWordFreqs(const std::string_view&) const;
+
+    // Interns the words, entries are sorted by term id
+    std::vector<WordFreq> InternWordFreqs(const std::map<std::string_view, double>&);
+
+    // Records the document frequencies, fingerprint, length and term bounds of a document
+    // taking the next slot
+    void IndexDocumentStats(const std::vector<WordFreq>&, uint32_t length);
+
+    // Index accessors working both on owned data and on a mapped snapshot
+
+    inline size_t GetTermCount() const noexcept {
+        return mapped_index_ ? mapped_index_->GetTermCount() : terms_.GetTermCount();
+    }
+
+    inline TermId FindTerm(std::string_view word) const {
+        return mapped_index_ ? mapped_index_->FindTerm(word) : terms_.Find(word);
+    }
+
+    inline std::string_view GetTerm(TermId term_id) const {
+        return mapped_index_ ? mapped_index_->GetTerm(term_id) : terms_.GetTerm(term_id);
+    }
+
+    inline size_t GetSlotCount() const noexcept {
+        return mapped_index_ ? mapped_index_->GetSlotCount() : slot_document_ids_.size();
+    }
+
+    inline DocumentTable GetDocumentTable() const noexcept {
+        if (mapped_index_) {
+            return { mapped_index_->GetSlotDocumentIds(), mapped_index_->GetSlotRatings(), mapped_index_->GetSlotStatuses(), mapped_index_->GetSlotLengths() };
+        }
+        return { slot_document_ids_.data(), slot_ratings_.data(), slot_statuses_.data(), slot_lengths_.data() };
+    }
+
+    inline CollectionStats GetCollectionStats() const noexcept {
+        const int document_count = GetDocumentCount();
+        return { document_count, document_count > 0 ? static_cast<double>(total_document_length_) / document_count : 0.0 };
+    }
+
+    inline TermBounds GetTermBounds(TermId term_id, const PostingListView& postings) const noexcept {
+        return { postings.GetMaxTermFreq(), term_max_counts_[term_id], term_min_lengths_[term_id] };
+    }
+
+    // Returns -1 for unknown documents
+    inline int FindSlot(int document_id) const {
+        if (mapped_index_) {
+            return mapped_index_->FindSlot(document_id);
+        }
+        const auto it = document_to_slot_.find(document_id);
+        return it == document_to_slot_.end() ? -1 : it->second;
+    }
+
+    // Calls handler(const IndexSegment&, const std::vector<bool>& deleted) for every segment
+    // in slot order. The open segment removes documents in place and has an empty bitmap.
+    template <typename Handler>
+    void ForEachSegment(Handler handler) const {
+        static const std::vector<bool> no_tombstones;
+        for (const SealedSegment& segment : sealed_segments_) {
+            handler(*segment.index, segment.deleted);
+        }
+        handler(open_segment_, no_tombstones);
+    }
+
+    static inline bool IsDeleted(const IndexSegment& segment, const std::vector<bool>& deleted, int slot) {
+        return !deleted.empty() && deleted[slot - segment.GetBeginSlot()];
+    }
+
+    // Posting lists of the words in a segment, empty for the words it lacks
+    static inline std::vector<PostingListView> GetPostings(const IndexSegment& segment, const std::vector<TermId>& term_ids) {
+        std::vector<PostingListView> lists;
+        lists.reserve(term_ids.size());
+        for (const TermId term_id : term_ids) {
+            lists.push_back(segment.GetPostings(term_id));
+        }
+        return lists;
+    }
+
+    // Sealed segment holding the slot, nullptr for slots of the open segment
+    const SealedSegment* FindSealedSegment(int slot) const;
+
+    ArrayView<WordFreq> GetWordFreqs(int slot) const;
+
+    // Takes the document's words out of the document frequencies and sets its tombstone
+    // if it is in a sealed segment. Returns false for documents of the open segment,
+    // which the caller removes in place.
+    bool MarkDeleted(int slot);
+
+    // Starts a merge if none is running and SEGMENT_MERGE_FACTOR adjacent sealed
+    // segments share a size tier
+    void ScheduleMerge();
+
+    // Replaces the merged segments with the result if it is ready or wait is set
+    void InstallMerge(bool wait);
+
+    // Seals the open segment once it reaches the document limit
+    void SealOpenSegment();
+
+    // New slot of every slot in order, -1 for those of removed documents
+    std::vector<int> ComputeCompactSlots() const;
+
+    // All segments merged into one without the removed documents, slots given by ComputeCompactSlots
+    IndexSegment MergeLiveDocuments(const std::vector<int>& new_slots) const;
+
+    // Renumbers the live documents into dense slots once removed ones outnumber them and fill
+    // at least a segment, dropping the attributes, forward entries and tombstones kept for the
+    // removed ones. The rebuild costs O(slots) and at least as many removals precede it.
+    void CompactSlots();
+
+    // Applies writer(SearchServer&), already applied to source, without sealing or merging,
+    // then takes over the segments and the running merge of source
+    template <typename Writer>
+    void ReplayWrite(const SearchServer& source, Writer writer);
+
+    // Shares the sealed segments, open segment and running merge of a copy made of the same writes.
+    // Tombstones and the open segment are copied only if the layouts differ.
+    void AdoptSegments(const SearchServer& source);
+
+    // Ordering of FindTopDocuments results: by relevance, then by rating
+    static inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+        if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.relevance > rhs.relevance;
+    }
 
     inline bool IsStopWord(const std::string_view& word) const {
-        return stop_words_.count(static_cast<std::string>(word)) > 0;
+        return stop_words_.count(word) > 0;
     }
 
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string_view&) const;
+    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view&) const;
+
+    // is_valid tells whether the tokenizer found control characters in the word
+    QueryWord ParseQueryWord(std::string_view, bool is_valid) const;
 
-    QueryWord ParseQueryWord(std::string) const;
+    PreparedQuery ParseQuery(const std::string_view&) const;
 
-    Query ParseQuery(const std::string_view&) const;
+    // O(1): document frequencies are kept up to date by AddDocument and RemoveDocument
+    inline double ComputeWordInverseDocumentFreq(TermId term_id) const {
+        return log(GetDocumentCount() * 1.0 / document_freqs_[term_id]);
+    }
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string&) const;
+    // Recomputes the inverse document frequencies of a query for the current index
+    void UpdateQuery(PreparedQuery&) const;
 
-    template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy&&, const Query&, DocumentPredicate) const;
+    // O(Q + W): merges the sorted query words with the sorted words of the document
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchSlot(const PreparedQuery&, int slot) const;
+
+    // The engines take the weights of the plus words, indexed like them, and the scorer of a ranking
+
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Scorer>
+    std::vector<Document> FindAllDocuments(ExecutionPolicy&&, const PreparedQuery&, const std::vector<double>& weights, const Scorer&, DocumentPredicate) const;
+
+    // At most max_result_document_count_ documents, a superset of the top is not guaranteed
+    template <typename DocumentPredicate, typename Scorer>
+    std::vector<Document> FindPrunedDocuments(const PreparedQuery&, const std::vector<double>& weights, const Scorer&, DocumentPredicate) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Scorer>
+    std::vector<Document> FindConjunctiveDocuments(ExecutionPolicy&&, const PreparedQuery&, const std::vector<double>& weights, const Scorer&, DocumentPredicate) const;
+
+    // Top max_result_document_count_ documents of a parsed query
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Ranking>
+    std::vector<Document> RankDocuments(ExecutionPolicy&&, const PreparedQuery&, DocumentPredicate, QueryEngine, const Ranking&) const;
 
     template <typename StringContainer>
     void CheckValidity(const StringContainer&);
 
     template <typename StringContainer>
-    std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer&);
+    std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer&);
 };
 
 void RemoveDuplicates(SearchServer&);
@@ -143,23 +647,92 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw
 
 template <typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(policy, raw_query, document_predicate, QueryEngine::EXHAUSTIVE);
+}
 
-    std::vector<Document> result;
-    Query query = ParseQuery(raw_query);
+template <typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, QueryEngine engine) const {
+    return RankDocuments(policy, ParseQuery(raw_query), document_predicate, engine, TfIdfRanking());
+}
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(std::execution::seq, query, document_predicate);
+}
 
-    std::sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (abs(lhs.relevance - rhs.relevance) < 1e-6) {
-            return lhs.rating > rhs.rating;
-        }
-        else {
-            return lhs.relevance > rhs.relevance;
+template <typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentPredicate document_predicate, QueryEngine engine) const {
+    return RankDocuments(policy, query, document_predicate, engine, TfIdfRanking());
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, QueryEngine engine, const Ranking& ranking) const {
+    return RankDocuments(policy, ParseQuery(raw_query), document_predicate, engine, ranking);
+}
+
+template <typename ExecutionPolicy, typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query, DocumentStatus status, QueryEngine engine, const Ranking& ranking) const {
+    return FindTopDocuments(policy, ParseQuery(raw_query), status, engine, ranking);
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentPredicate document_predicate, QueryEngine engine, const Ranking& ranking) const {
+    return RankDocuments(policy, query, document_predicate, engine, ranking);
+}
+
+template <typename ExecutionPolicy, typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentStatus status, QueryEngine engine, const Ranking& ranking) const {
+    return RankDocuments(
+        policy,
+        query,
+        [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        },
+        engine,
+        ranking);
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Ranking>
+std::vector<Document> SearchServer::RankDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentPredicate document_predicate, QueryEngine engine, const Ranking& ranking) const {
+
+    if (query.generation_ != generation_) {
+        PreparedQuery updated_query = query;
+        UpdateQuery(updated_query);
+        return RankDocuments(policy, updated_query, document_predicate, engine, ranking);
+    }
+    SEARCH_STAGE_TIMER(rank);
+    SEARCH_COUNTER_ADD(queries, 1);
+
+    const auto scorer = ranking.MakeScorer(GetCollectionStats());
+    // TF-IDF weights come with the query, other rankings weigh the words here
+    std::vector<double> ranking_weights;
+    if constexpr (!std::is_same_v<Ranking, TfIdfRanking>) {
+        SEARCH_STAGE_TIMER(idf);
+        for (const TermId term_id : query.plus_words_) {
+            ranking_weights.push_back(document_freqs_[term_id] == 0 ? 0 : scorer.ComputeWeight(document_freqs_[term_id]));
         }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
+    const std::vector<double>& weights = std::is_same_v<Ranking, TfIdfRanking> ? query.inverse_document_freqs_ : ranking_weights;
+
+    std::vector<Document> result;
+
+    std::vector<Document> matched_documents;
+    switch (engine) {
+    case QueryEngine::MAX_SCORE:
+        matched_documents = FindPrunedDocuments(query, weights, scorer, document_predicate);
+        break;
+    case QueryEngine::CONJUNCTIVE:
+        matched_documents = FindConjunctiveDocuments(policy, query, weights, scorer, document_predicate);
+        break;
+    default:
+        matched_documents = FindAllDocuments(policy, query, weights, scorer, document_predicate);
+    }
+
+    // O(M log K): only the first K documents are ordered
+    SEARCH_STAGE_TIMER(top_k);
+    const size_t top_count = std::min(matched_documents.size(), max_result_document_count_);
+    std::partial_sort(policy, matched_documents.begin(), matched_documents.begin() + top_count, matched_documents.end(), IsMoreRelevant);
+    matched_documents.resize(top_count);
 
     result.swap(matched_documents);
     return result;
@@ -167,13 +740,47 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, c
 
 template<typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query, DocumentStatus status) const {
+    return FindTopDocuments(policy, raw_query, status, QueryEngine::EXHAUSTIVE);
+}
 
-    return FindTopDocuments(
-        policy,
-        raw_query,
-        [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+template<typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query, DocumentStatus status, QueryEngine engine) const {
+    return FindTopDocuments(policy, ParseQuery(raw_query), status, engine);
+}
+
+template<typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query) const {
+    return FindTopDocuments(policy, query, DocumentStatus::ACTUAL);
+}
+
+template<typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentStatus status, QueryEngine engine) const {
+
+    const auto rank = [&]() {
+        return RankDocuments(
+            policy,
+            query,
+            [status](int, DocumentStatus document_status, int) {
+                return document_status == status;
+            },
+            engine,
+            TfIdfRanking());
+    };
+    if (!query_cache_.IsEnabled()) {
+        return rank();
+    }
+
+    // EXHAUSTIVE and MAX_SCORE under any policy give the same top, so they share entries
+    QueryCache::Key key{ query.plus_words_, query.minus_words_, static_cast<int>(status), engine == QueryEngine::CONJUNCTIVE };
+    if (key.is_conjunctive && query.has_unknown_plus_words_) {
+        key.plus_words.push_back(TermDictionary::INVALID_TERM_ID);
+    }
+    if (auto cached = query_cache_.Find(key, generation_)) {
+        return std::move(*cached);
+    }
+    std::vector<Document> result = rank();
+    query_cache_.Insert(std::move(key), generation_, result);
+    return result;
 }
 
 template<typename ExecutionPolicy>
@@ -181,80 +788,380 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, c
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate, typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [this, &document_predicate, &document_to_relevance](const std::string& word) {
-        if (this->word_to_doc_freqs_.count(word) != 0) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_doc_freqs_.at(word)) {
-                const auto& document_data = this->documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Scorer>
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, const std::vector<double>& weights, const Scorer& scorer, DocumentPredicate document_predicate) const {
+    const DocumentTable documents = GetDocumentTable();
+    std::vector<std::pair<const IndexSegment*, const std::vector<bool>*>> segments;
+    ForEachSegment([&segments](const IndexSegment& segment, const std::vector<bool>& deleted) {
+        segments.push_back({ &segment, &deleted });
+        });
+
+    // Segments hold disjoint slot ranges, so each one is scored into its own dense accumulator
+    std::vector<std::vector<Document>> segment_documents(segments.size());
+    std::transform(policy, segments.begin(), segments.end(), segment_documents.begin(), [&](const auto& entry) {
+        const auto [segment, deleted] = entry;
+        ScoreAccumulator& accumulator = ScoreAccumulator::GetThreadLocal();
+        accumulator.Reset(segment->GetBeginSlot(), segment->GetSlotCount());
+        {
+            SEARCH_STAGE_TIMER(score);
+            // Documents with minus words are skipped while the postings are scanned, so they are never scored
+            const std::vector<PostingListView> minus_lists = GetPostings(*segment, query.minus_words_);
+            for (size_t i = 0; i < query.plus_words_.size(); ++i) {
+                if (document_freqs_[query.plus_words_[i]] == 0) {
+                    continue;
                 }
+                const double weight = weights[i];
+                ForEachPostingExcept(segment->GetPostings(query.plus_words_[i]), minus_lists, [&accumulator, &scorer, &documents, weight](const Posting posting) {
+                    accumulator.Add(posting.document_id, scorer.Score(weight, posting.term_freq, documents.lengths[posting.document_id]));
+                    });
             }
         }
+
+        // Deleted documents and the predicate are checked once per scored document, not per posting
+        SEARCH_STAGE_TIMER(materialize);
+        std::vector<Document> result;
+        result.reserve(accumulator.GetTouchedCount());
+        accumulator.ForEachScore([&](const int slot, const double relevance) {
+            if (!IsDeleted(*segment, *deleted, slot)
+                && document_predicate(documents.document_ids[slot], documents.statuses[slot], documents.ratings[slot])) {
+                result.push_back({ documents.document_ids[slot], relevance, documents.ratings[slot] });
+            }
+            });
+        return result;
         });
 
-    std::for_each(policy, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](const std::string& word) {
-        if (this->word_to_doc_freqs_.count(word) != 0) {
-            for (const auto [document_id, _] : this->word_to_doc_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
+    std::vector<Document> matched_documents;
+    for (const std::vector<Document>& result : segment_documents) {
+        matched_documents.insert(matched_documents.end(), result.begin(), result.end());
+    }
+    return matched_documents;
+}
+
+template <typename ExecutionPolicy, typename DocumentContainer>
+void SearchServer::AddDocuments(ExecutionPolicy&& policy, const DocumentContainer& documents) {
+    CheckWritable();
+    InstallMerge(false);
+    std::set<int> batch_ids;
+    for (const DocumentInput& document : documents) {
+        CheckNewDocumentId(document.id);
+        if (!batch_ids.insert(document.id).second) {
+            throw std::invalid_argument("ID already exists"s);
+        }
+    }
+
+    // Tokenizing is independent per document
+    std::vector<DocumentWordFreqs> batch_word_freqs(batch_ids.size());
+    std::transform(policy, std::begin(documents), std::end(documents), batch_word_freqs.begin(), [this](const DocumentInput& document) {
+        return ComputeWordFreqs(document.text);
+        });
+
+    // The dictionary is not thread-safe, so words are interned in one pass
+    std::vector<std::vector<WordFreq>> batch;
+    batch.reserve(batch_word_freqs.size());
+    for (const DocumentWordFreqs& document_word_freqs : batch_word_freqs) {
+        batch.push_back(InternWordFreqs(document_word_freqs.word_freqs));
+        IndexDocumentStats(batch.back(), document_word_freqs.length);
+    }
+    open_segment_.AddDocuments(policy, std::move(batch));
+
+    for (const DocumentInput& document : documents) {
+        document_to_slot_.emplace(document.id, static_cast<int>(slot_document_ids_.size()));
+        slot_document_ids_.push_back(document.id);
+        slot_ratings_.push_back(ComputeAverageRating(document.ratings));
+        slot_statuses_.push_back(document.status);
+    }
+    ++generation_;
+    SEARCH_COUNTER_ADD(documents_added, documents.size());
+    SealOpenSegment();
+}
+
+template <typename DocumentPredicate, typename Scorer>
+std::vector<Document> SearchServer::FindPrunedDocuments(const PreparedQuery& query, const std::vector<double>& weights, const Scorer& scorer, DocumentPredicate document_predicate) const {
+    SEARCH_STAGE_TIMER(score);
+    // A document within this distance of the current threshold may still win on rating
+    constexpr double EPSILON = 1e-6;
+
+    struct TermCursor {
+        PostingListView::Iterator it;
+        PostingListView::Iterator end;
+        double weight;
+        double upper_bound;
+        // position in query.plus_words_, scores are summed in that order as in FindAllDocuments
+        size_t index;
+    };
+
+    const size_t top_count = max_result_document_count_;
+    std::vector<Document> top;
+    if (top_count == 0) {
+        return top;
+    }
+
+    const DocumentTable documents = GetDocumentTable();
+    double threshold = 0;
+    std::vector<double> contributions(query.plus_words_.size(), 0.0);
+    std::vector<bool> matched(query.plus_words_.size(), false);
+
+    // top is a heap with the least relevant document at the front
+    auto worse = [](const Document& lhs, const Document& rhs) {
+        return IsMoreRelevant(lhs, rhs);
+    };
+
+    // Segments hold increasing slot ranges, so they are scanned one after another
+    // and the top with its threshold carries over to the next segment
+    ForEachSegment([&](const IndexSegment& segment, const std::vector<bool>& deleted) {
+        std::vector<TermCursor> cursors;
+        for (size_t i = 0; i < query.plus_words_.size(); ++i) {
+            const TermId term_id = query.plus_words_[i];
+            const PostingListView postings = segment.GetPostings(term_id);
+            if (postings.empty() || document_freqs_[term_id] == 0) {
+                continue;
+            }
+            const double weight = weights[i];
+            cursors.push_back({ postings.begin(), postings.end(), weight, scorer.ComputeScoreBound(weight, GetTermBounds(term_id, postings)), i });
+        }
+        if (cursors.empty()) {
+            return;
+        }
+        ExclusionCursors exclusion(GetPostings(segment, query.minus_words_));
+
+        // Cursors ordered by upper bound, bound_prefix[i] is the sum of the bounds of cursors [0, i)
+        std::sort(cursors.begin(), cursors.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+            return lhs.upper_bound < rhs.upper_bound;
+            });
+        std::vector<double> bound_prefix(cursors.size() + 1, 0.0);
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            bound_prefix[i + 1] = bound_prefix[i] + cursors[i].upper_bound;
+        }
+
+        // Cursors [0, essential) can't lift a document into the top on their own,
+        // so only the rest produce candidates
+        size_t essential = 0;
+        if (top.size() == top_count) {
+            while (essential < cursors.size() && bound_prefix[essential + 1] < threshold - EPSILON) {
+                ++essential;
+            }
+        }
+
+        while (true) {
+            int slot = std::numeric_limits<int>::max();
+            for (size_t i = essential; i < cursors.size(); ++i) {
+                if (cursors[i].it != cursors[i].end) {
+                    slot = std::min(slot, (*cursors[i].it).document_id);
+                }
+            }
+            if (slot == std::numeric_limits<int>::max()) {
+                break;
+            }
+
+            double score = 0;
+            std::fill(matched.begin(), matched.end(), false);
+            for (size_t i = essential; i < cursors.size(); ++i) {
+                TermCursor& cursor = cursors[i];
+                if (cursor.it != cursor.end && (*cursor.it).document_id == slot) {
+                    contributions[cursor.index] = scorer.Score(cursor.weight, (*cursor.it).term_freq, documents.lengths[slot]);
+                    matched[cursor.index] = true;
+                    score += contributions[cursor.index];
+                    ++cursor.it;
+                }
+            }
+
+            if (IsDeleted(segment, deleted, slot)
+                || !document_predicate(documents.document_ids[slot], documents.statuses[slot], documents.ratings[slot])) {
+                continue;
+            }
+
+            bool is_candidate = true;
+            for (size_t i = essential; i-- > 0;) {
+                if (top.size() == top_count && score + bound_prefix[i + 1] < threshold - EPSILON) {
+                    is_candidate = false;
+                    break;
+                }
+                TermCursor& cursor = cursors[i];
+                cursor.it.SkipTo(slot);
+                if (cursor.it != cursor.end && (*cursor.it).document_id == slot) {
+                    contributions[cursor.index] = scorer.Score(cursor.weight, (*cursor.it).term_freq, documents.lengths[slot]);
+                    matched[cursor.index] = true;
+                    score += contributions[cursor.index];
+                }
+            }
+            if (!is_candidate) {
+                continue;
+            }
+
+            if (exclusion.IsExcluded(slot)) {
+                continue;
+            }
+
+            double relevance = 0;
+            for (size_t i = 0; i < matched.size(); ++i) {
+                if (matched[i]) {
+                    relevance += contributions[i];
+                }
+            }
+            const Document document(documents.document_ids[slot], relevance, documents.ratings[slot]);
+
+            if (top.size() < top_count) {
+                top.push_back(document);
+                std::push_heap(top.begin(), top.end(), worse);
+            }
+            else if (IsMoreRelevant(document, top.front())) {
+                std::pop_heap(top.begin(), top.end(), worse);
+                top.back() = document;
+                std::push_heap(top.begin(), top.end(), worse);
+            }
+            else {
+                continue;
+            }
+
+            if (top.size() == top_count) {
+                threshold = top.front().relevance;
+                while (essential < cursors.size() && bound_prefix[essential + 1] < threshold - EPSILON) {
+                    ++essential;
+                }
             }
         }
         });
 
+    return top;
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Scorer>
+std::vector<Document> SearchServer::FindConjunctiveDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, const std::vector<double>& weights, const Scorer& scorer, DocumentPredicate document_predicate) const {
+    SEARCH_STAGE_TIMER(score);
     std::vector<Document> matched_documents;
-    matched_documents.reserve(document_to_relevance.size());
+    if (query.plus_words_.empty() || query.has_unknown_plus_words_) {
+        return matched_documents;
+    }
+    for (const TermId term_id : query.plus_words_) {
+        if (document_freqs_[term_id] == 0) {
+            return matched_documents;
+        }
+    }
 
-    auto pred = [&matched_documents, this](const std::pair<int, double>& p) {
-        matched_documents.push_back({ p.first, p.second, this->documents_.at(p.first).rating });
-    };
-    std::for_each(policy, document_to_relevance.begin(), document_to_relevance.end(), pred);
+    const DocumentTable documents = GetDocumentTable();
+    std::vector<std::pair<const IndexSegment*, const std::vector<bool>*>> segments;
+    ForEachSegment([&segments](const IndexSegment& segment, const std::vector<bool>& deleted) {
+        segments.push_back({ &segment, &deleted });
+        });
+
+    std::vector<std::vector<Document>> segment_documents(segments.size());
+    std::transform(policy, segments.begin(), segments.end(), segment_documents.begin(), [&](const auto& entry) {
+        const auto [segment, deleted] = entry;
+        std::vector<Document> result;
+        ForEachIntersection(GetPostings(*segment, query.plus_words_), GetPostings(*segment, query.minus_words_), [&](int slot, const std::vector<double>& term_freqs) {
+            if (IsDeleted(*segment, *deleted, slot)
+                || !document_predicate(documents.document_ids[slot], documents.statuses[slot], documents.ratings[slot])) {
+                return;
+            }
+            double relevance = 0;
+            for (size_t i = 0; i < term_freqs.size(); ++i) {
+                relevance += scorer.Score(weights[i], term_freqs[i], documents.lengths[slot]);
+            }
+            result.push_back({ documents.document_ids[slot], relevance, documents.ratings[slot] });
+            });
+        return result;
+        });
 
+    for (const std::vector<Document>& result : segment_documents) {
+        matched_documents.insert(matched_documents.end(), result.begin(), result.end());
+    }
     return matched_documents;
 }
 
 template<typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    if (doc_to_word_freqs_.count(document_id)) {
+    CheckWritable();
+    InstallMerge(false);
+    const auto slot_it = document_to_slot_.find(document_id);
+    if (slot_it == document_to_slot_.end()) {
+        return;
+    }
+    const int slot = slot_it->second;
 
-        this->doc_to_word_freqs_.erase(document_id);
-        this->documents_.erase(document_id);
+    if (!MarkDeleted(slot)) {
+        open_segment_.RemoveDocument(policy, slot);
+    }
+    document_to_slot_.erase(slot_it);
+    ++generation_;
+    SEARCH_COUNTER_ADD(documents_removed, 1);
+    CompactSlots();
+}
 
-        auto it = std::lower_bound(document_id_.begin(), document_id_.end(), document_id);
-        std::future<void> f3 = std::async([it, this] {this->document_id_.erase(it); });
+template<typename ExecutionPolicy, typename IdContainer>
+void SearchServer::RemoveDocuments(ExecutionPolicy&& policy, const IdContainer& document_ids) {
+    CheckWritable();
+    InstallMerge(false);
+    std::vector<int> open_slots;
+    size_t removed_count = 0;
+    for (const int document_id : document_ids) {
+        const auto slot_it = document_to_slot_.find(document_id);
+        if (slot_it == document_to_slot_.end()) {
+            continue;
+        }
+        if (!MarkDeleted(slot_it->second)) {
+            open_slots.push_back(slot_it->second);
+        }
+        document_to_slot_.erase(slot_it);
+        ++removed_count;
+    }
+    SEARCH_COUNTER_ADD(documents_removed, removed_count);
 
-        std::for_each(policy, word_to_doc_freqs_.begin(), word_to_doc_freqs_.end(), [document_id](auto& word) {
-            if (word.second.find(document_id) != word.second.end()) {
-                word.second.erase(document_id);
-            }
-            });
+    std::sort(open_slots.begin(), open_slots.end());
+    open_segment_.RemoveDocuments(policy, open_slots);
+    ++generation_;
+    CompactSlots();
+}
+
+template <typename Writer>
+void SearchServer::ReplayWrite(const SearchServer& source, Writer writer) {
+    is_replaying_ = true;
+    try {
+        writer(*this);
+    }
+    catch (...) {
+        is_replaying_ = false;
+        throw;
     }
+    is_replaying_ = false;
+    AdoptSegments(source);
 }
 
 template<typename ExecutionPolicy>
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(ExecutionPolicy&& policy, const std::string_view& raw_query, int document_id) const {
+    return MatchDocument(policy, ParseQuery(raw_query), document_id);
+}
 
-    Query query = ParseQuery(raw_query);
+// One document is too little work to share between threads, the policy matters for MatchDocuments
+template<typename ExecutionPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(ExecutionPolicy&&, const PreparedQuery& query, int document_id) const {
+    const int slot = FindSlot(document_id);
+    if (slot < 0) {
+        throw std::out_of_range("document not found"s);
+    }
+    return MatchSlot(query, slot);
+}
 
-    std::vector<std::string_view> matched_words;
-    const std::map<std::string, double>& doc = doc_to_word_freqs_.at(document_id);
-    
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [&matched_words, &doc](const std::string& word) {
-        auto it = doc.find(word);
-        if (it != doc.end())
-            matched_words.push_back(std::string_view(it->first));
-        });
+template<typename ExecutionPolicy, typename IdContainer>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query, const IdContainer& document_ids) const {
+    return MatchDocuments(policy, ParseQuery(raw_query), document_ids);
+}
 
-    if (std::any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&doc](std::string word) {
-        return doc.count(word);
-        })){
-        matched_words.clear();
+template<typename ExecutionPolicy, typename IdContainer>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, const IdContainer& document_ids) const {
+    std::vector<int> slots;
+    for (const int document_id : document_ids) {
+        const int slot = FindSlot(document_id);
+        if (slot < 0) {
+            throw std::out_of_range("document not found"s);
+        }
+        slots.push_back(slot);
     }
 
-    return { matched_words, documents_.at(document_id).status };
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> result(slots.size());
+    std::transform(policy, slots.begin(), slots.end(), result.begin(), [this, &query](const int slot) {
+        return MatchSlot(query, slot);
+        });
+    return result;
 }
 
 template <typename StringContainer>
@@ -267,8 +1174,8 @@ void SearchServer::CheckValidity(const StringContainer& strings) {
 }
 
 template <typename StringContainer>
-std::set<std::string> SearchServer::MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
+std::set<std::string, std::less<>> SearchServer::MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
     for (const auto& str : strings) {
         non_empty_strings.emplace(str);
     }
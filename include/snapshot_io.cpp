@@ -0,0 +1,86 @@
+#include "snapshot_io.h"
+
+uint64_t ComputeChecksum(const char* data, size_t size, uint64_t seed) {
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path) : out_(path, std::ios::binary | std::ios::trunc) {
+    if (!out_) {
+        throw std::runtime_error("can't create snapshot " + path);
+    }
+    WriteBytes(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    WriteBytes(&SNAPSHOT_VERSION, sizeof(SNAPSHOT_VERSION));
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    checksum_ = ComputeChecksum(static_cast<const char*>(data), size, checksum_);
+    out_.write(static_cast<const char*>(data), size);
+    size_ += size;
+}
+
+void SnapshotWriter::Align() {
+    static const char padding[SNAPSHOT_ALIGNMENT] = {};
+    WriteBytes(padding, (SNAPSHOT_ALIGNMENT - size_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+}
+
+void SnapshotWriter::Finish() {
+    const uint64_t checksum = checksum_;
+    out_.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    out_.flush();
+    if (!out_) {
+        throw std::runtime_error("failed to write snapshot");
+    }
+}
+
+SnapshotReader::SnapshotReader(const char* data, size_t size, bool verify_checksum) : data_(data) {
+    const size_t header_size = sizeof(SNAPSHOT_MAGIC) + sizeof(SNAPSHOT_VERSION);
+    if (size < header_size + sizeof(uint64_t)) {
+        throw std::runtime_error("snapshot is truncated");
+    }
+    if (std::memcmp(data_, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error("not a search server snapshot");
+    }
+    uint32_t version;
+    std::memcpy(&version, data_ + sizeof(SNAPSHOT_MAGIC), sizeof(version));
+    if (version != SNAPSHOT_VERSION) {
+        throw std::runtime_error("unsupported snapshot version");
+    }
+
+    end_ = size - sizeof(uint64_t);
+    if (verify_checksum) {
+        uint64_t checksum;
+        std::memcpy(&checksum, data_ + end_, sizeof(checksum));
+        if (checksum != ComputeChecksum(data_, end_)) {
+            throw std::runtime_error("snapshot checksum mismatch");
+        }
+    }
+    offset_ = header_size;
+}
+
+const char* SnapshotReader::ReadBytes(size_t size) {
+    if (size > end_ - offset_) {
+        throw std::runtime_error("snapshot is truncated");
+    }
+    const char* result = data_ + offset_;
+    offset_ += size;
+    return result;
+}
+
+std::pair<ArrayView<uint64_t>, ArrayView<char>> SnapshotReader::ReadStrings() {
+    const ArrayView<uint64_t> offsets = ReadArray<uint64_t>();
+    const ArrayView<char> chars = ReadArray<char>();
+    if (offsets.empty() || offsets.back() != chars.size()) {
+        throw std::runtime_error("snapshot has corrupted strings");
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+        if (offsets[i] < offsets[i - 1]) {
+            throw std::runtime_error("snapshot has corrupted strings");
+        }
+    }
+    return { offsets, chars };
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Binary snapshot files: a header {magic, version}, sections written as raw arrays,
+// and a trailing FNV-1a checksum of everything before it. Every array starts at an
+// 8-byte aligned offset, so a memory-mapped file can be used in place.
+// Values are stored in host byte order, a snapshot is meant to be read on the machine
+// type that wrote it.
+inline constexpr char SNAPSHOT_MAGIC[4] = { 'Y', 'P', 'S', 'S' };
+inline constexpr uint32_t SNAPSHOT_VERSION = 3;
+inline constexpr size_t SNAPSHOT_ALIGNMENT = 8;
+
+uint64_t ComputeChecksum(const char* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+// Non-owning view of a contiguous array
+template <typename T>
+class ArrayView {
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+
+public:
+    ArrayView() = default;
+    ArrayView(const T* data, size_t size) : data_(data), size_(size) {}
+    ArrayView(const std::vector<T>& values) : data_(values.data()), size_(values.size()) {}
+
+    inline const T* begin() const noexcept { return data_; }
+    inline const T* end() const noexcept { return data_ + size_; }
+    inline const T* data() const noexcept { return data_; }
+    inline size_t size() const noexcept { return size_; }
+    inline bool empty() const noexcept { return size_ == 0; }
+    inline const T& operator[](size_t index) const { return data_[index]; }
+    inline const T& back() const { return data_[size_ - 1]; }
+};
+
+class SnapshotWriter {
+    std::ofstream out_;
+    uint64_t checksum_ = ComputeChecksum(nullptr, 0);
+    uint64_t size_ = 0;
+
+    void Align();
+
+public:
+    // Writes the header. Throws std::runtime_error if the file can't be created.
+    explicit SnapshotWriter(const std::string& path);
+
+    void WriteBytes(const void* data, size_t size);
+
+    inline void Write(uint64_t value) {
+        WriteBytes(&value, sizeof(value));
+    }
+
+    // Element count followed by the raw elements, padded to the alignment
+    template <typename T>
+    void WriteArray(ArrayView<T> values) {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= SNAPSHOT_ALIGNMENT);
+        Write(values.size());
+        WriteBytes(values.data(), values.size() * sizeof(T));
+        Align();
+    }
+
+    template <typename T>
+    void WriteArray(const std::vector<T>& values) {
+        WriteArray(ArrayView<T>(values));
+    }
+
+    // Offsets of the strings (one more than their count) followed by the concatenated characters
+    template <typename StringContainer>
+    void WriteStrings(const StringContainer& strings) {
+        std::vector<uint64_t> offsets = { 0 };
+        std::string chars;
+        for (const auto& str : strings) {
+            chars += str;
+            offsets.push_back(chars.size());
+        }
+        WriteArray(offsets);
+        WriteArray(ArrayView<char>(chars.data(), chars.size()));
+    }
+
+    // Appends the checksum and flushes. Throws std::runtime_error on write errors.
+    void Finish();
+};
+
+// Reads sections from a snapshot held in memory, without copying.
+// Checks the header up front and the checksum if asked to.
+// All accessors throw std::runtime_error if the data is truncated.
+class SnapshotReader {
+    const char* data_ = nullptr;
+    size_t offset_ = 0;
+    size_t end_ = 0;
+
+public:
+    // The data must be aligned to SNAPSHOT_ALIGNMENT and outlive the reader
+    SnapshotReader(const char* data, size_t size, bool verify_checksum);
+
+    const char* ReadBytes(size_t size);
+
+    inline uint64_t Read() {
+        uint64_t value;
+        std::memcpy(&value, ReadBytes(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    template <typename T>
+    ArrayView<T> ReadArray() {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= SNAPSHOT_ALIGNMENT);
+        const uint64_t count = Read();
+        if (count > (end_ - offset_) / sizeof(T)) {
+            throw std::runtime_error("snapshot is truncated");
+        }
+        const T* values = reinterpret_cast<const T*>(ReadBytes(count * sizeof(T)));
+        ReadBytes((SNAPSHOT_ALIGNMENT - offset_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+        return ArrayView<T>(values, count);
+    }
+
+    // Strings written by SnapshotWriter::WriteStrings, as offsets and characters
+    std::pair<ArrayView<uint64_t>, ArrayView<char>> ReadStrings();
+
+    inline bool AtEnd() const noexcept {
+        return offset_ == end_;
+    }
+};
@@ -1,22 +1,9 @@
 #include "string_processing.h"
-#include <execution>
 
-std::vector<std::string> SplitIntoWords(const std::string_view& text) {
-    std::vector<std::string> words;
-    std::string word;
-    for (const char c : text) {
-        if (c == ' ') {
-            if (!word.empty()) {
-                words.push_back({ word });
-                word.clear();
-            }
-        }
-        else {
-            word += c;
-        }
-    }
-    if (!word.empty()) {
+std::vector<std::string_view> SplitIntoWords(const std::string_view& text) {
+    std::vector<std::string_view> words;
+    ForEachWord(text, [&words](std::string_view word, bool) {
         words.push_back(word);
-    }
+        });
     return words;
-}
\ No newline at end of file
+}
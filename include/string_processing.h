@@ -1,6 +1,128 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
 
-std::vector<std::string> SplitIntoWords(const std::string_view&);
\ No newline at end of file
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace string_processing_detail {
+
+#if defined(__AVX2__)
+inline constexpr size_t BLOCK_SIZE = 32;
+#else
+inline constexpr size_t BLOCK_SIZE = 16;
+#endif
+
+// Bit i of spaces/controls is set if text[i] is a space/a control character ('\0'..'\x1f')
+inline void ClassifyScalar(const char* text, size_t size, uint64_t& spaces, uint64_t& controls) {
+    spaces = 0;
+    controls = 0;
+    for (size_t i = 0; i < size; ++i) {
+        const char c = text[i];
+        spaces |= static_cast<uint64_t>(c == ' ') << i;
+        controls |= static_cast<uint64_t>(c >= '\0' && c < ' ') << i;
+    }
+}
+
+inline void ClassifyBlock(const char* text, uint64_t& spaces, uint64_t& controls) {
+#if defined(__AVX2__)
+    const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text));
+    const __m256i is_space = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' '));
+    const __m256i is_control = _mm256_and_si256(
+        _mm256_cmpgt_epi8(chars, _mm256_set1_epi8(-1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(' '), chars));
+    spaces = static_cast<uint32_t>(_mm256_movemask_epi8(is_space));
+    controls = static_cast<uint32_t>(_mm256_movemask_epi8(is_control));
+#elif defined(__SSE2__)
+    const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+    const __m128i is_space = _mm_cmpeq_epi8(chars, _mm_set1_epi8(' '));
+    const __m128i is_control = _mm_and_si128(
+        _mm_cmpgt_epi8(chars, _mm_set1_epi8(-1)),
+        _mm_cmplt_epi8(chars, _mm_set1_epi8(' ')));
+    spaces = static_cast<uint32_t>(_mm_movemask_epi8(is_space));
+    controls = static_cast<uint32_t>(_mm_movemask_epi8(is_control));
+#else
+    ClassifyScalar(text, BLOCK_SIZE, spaces, controls);
+#endif
+}
+
+// Index of the lowest set bit, mask must not be zero
+inline size_t LowestBit(uint64_t mask) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_ctzll(mask));
+#else
+    size_t index = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
+} // namespace string_processing_detail
+
+// Calls handler(std::string_view word, bool is_valid) for every space-separated word of the text.
+// A word is valid if it has no control characters. Words are views into the text, nothing is allocated.
+// Spaces and control characters are located a whole block at a time with SSE2/AVX2 when available.
+template <typename Handler>
+void ForEachWord(std::string_view text, Handler handler) {
+    using namespace string_processing_detail;
+
+    bool in_word = false;
+    bool word_is_valid = true;
+    size_t word_begin = 0;
+
+    for (size_t base = 0; base < text.size(); base += BLOCK_SIZE) {
+        const size_t block_size = std::min(BLOCK_SIZE, text.size() - base);
+        uint64_t spaces;
+        uint64_t controls;
+        if (block_size == BLOCK_SIZE) {
+            ClassifyBlock(text.data() + base, spaces, controls);
+        }
+        else {
+            ClassifyScalar(text.data() + base, block_size, spaces, controls);
+        }
+        const uint64_t block_mask = (uint64_t(1) << block_size) - 1;
+
+        size_t pos = 0;
+        while (pos < block_size) {
+            const uint64_t from_pos = block_mask & (~uint64_t(0) << pos);
+            if (!in_word) {
+                const uint64_t non_spaces = ~spaces & from_pos;
+                if (non_spaces == 0) {
+                    break;
+                }
+                pos = LowestBit(non_spaces);
+                in_word = true;
+                word_is_valid = true;
+                word_begin = base + pos;
+                continue;
+            }
+
+            const uint64_t word_spaces = spaces & from_pos;
+            const size_t word_end = word_spaces ? LowestBit(word_spaces) : block_size;
+            const uint64_t word_mask = from_pos & ~(~uint64_t(0) << word_end);
+            if (controls & word_mask) {
+                word_is_valid = false;
+            }
+            if (word_spaces == 0) {
+                break;
+            }
+            handler(text.substr(word_begin, base + word_end - word_begin), word_is_valid);
+            in_word = false;
+            pos = word_end + 1;
+        }
+    }
+
+    if (in_word) {
+        handler(text.substr(word_begin), word_is_valid);
+    }
+}
+
+std::vector<std::string_view> SplitIntoWords(const std::string_view&);
@@ -0,0 +1,31 @@
+#include "term_dictionary.h"
+
+TermDictionary::TermDictionary(const TermDictionary& other) : terms_(other.terms_) {
+    ids_.reserve(terms_.size());
+    for (size_t i = 0; i < terms_.size(); ++i) {
+        ids_.emplace(terms_[i], static_cast<TermId>(i));
+    }
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        TermDictionary copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+TermId TermDictionary::Intern(std::string_view word) {
+    const auto it = ids_.find(word);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    const TermId term_id = static_cast<TermId>(terms_.size());
+    ids_.emplace(terms_.emplace_back(word), term_id);
+    return term_id;
+}
+
+TermId TermDictionary::Find(std::string_view word) const {
+    const auto it = ids_.find(word);
+    return it == ids_.end() ? INVALID_TERM_ID : it->second;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using TermId = uint32_t;
+
+// Stores every distinct word of the index once and gives it a dense id.
+// Views returned by GetTerm stay valid for the lifetime of the dictionary.
+class TermDictionary {
+    // deque never relocates its elements, so the views in ids_ stay valid
+    std::deque<std::string> terms_;
+    std::unordered_map<std::string_view, TermId> ids_;
+
+public:
+    inline static constexpr TermId INVALID_TERM_ID = static_cast<TermId>(-1);
+
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary&);
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(const TermDictionary&);
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    // Returns the id of the word, adding it on first use
+    TermId Intern(std::string_view);
+
+    // Returns INVALID_TERM_ID for unknown words
+    TermId Find(std::string_view) const;
+
+    inline std::string_view GetTerm(TermId term_id) const {
+        return terms_[term_id];
+    }
+
+    inline size_t GetTermCount() const noexcept {
+        return terms_.size();
+    }
+};
@@ -354,6 +354,1115 @@ void TestMultiThread1() {
     */
 }
 
+void TestParallelFindTopDocuments() {
+    SearchServer server = GetTestServer();
+    const std::string_view query = "1word2 2word1 3word1 3word2 3word3 4word1 5word5 5word2 6word3 6word1 -4word2"sv;
+
+    for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED, DocumentStatus::IRRELEVANT, DocumentStatus::REMOVED }) {
+        const std::vector<Document> seq = server.FindTopDocuments(std::execution::seq, query, status);
+        const std::vector<Document> par = server.FindTopDocuments(std::execution::par, query, status);
+
+        ASSERT_EQUAL(seq.size(), par.size());
+        for (size_t i = 0; i < seq.size(); ++i) {
+            ASSERT_EQUAL(seq[i].id, par[i].id);
+            ASSERT(is_equal(seq[i].relevance, par[i].relevance));
+        }
+    }
+}
+
+void TestInverseDocumentFreqFollowsIndex() {
+    SearchServer server;
+    server.AddDocument(1, "cat dog"sv, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "cat"sv, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(3, "bird"sv, DocumentStatus::ACTUAL, { 1 });
+
+    std::vector<Document> fd = server.FindTopDocuments("cat"sv);
+    ASSERT_EQUAL(fd.size(), 2);
+    ASSERT(is_equal(fd[0].relevance, std::log(3.0 / 2.0)));
+
+    server.RemoveDocument(1);
+    fd = server.FindTopDocuments("cat"sv);
+    ASSERT_EQUAL(fd.size(), 1);
+    ASSERT(is_equal(fd[0].relevance, std::log(2.0 / 1.0)));
+
+    server.AddDocument(4, "cat"sv, DocumentStatus::ACTUAL, { 1 });
+    fd = server.FindTopDocuments("cat"sv);
+    ASSERT_EQUAL(fd.size(), 2);
+    ASSERT(is_equal(fd[0].relevance, std::log(3.0 / 2.0)));
+}
+
+void TestMatchDocumentReturnsDictionaryWords() {
+    SearchServer server("and"sv);
+    server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, { 1 });
+
+    std::vector<std::string_view> words;
+    {
+        const std::string query = "rat funny rat and unknown"s;
+        words = std::get<0>(server.MatchDocument(query, 1));
+    }
+
+    // views must outlive the query text and contain every word once
+    ASSERT_EQUAL(words.size(), 2);
+    ASSERT(words[0] == "funny"sv);
+    ASSERT(words[1] == "rat"sv);
+}
+
+void TestPostingList() {
+    PostingList postings;
+
+    // several blocks with multi-byte deltas, filled out of order
+    for (int id = 1000; id >= 0; id -= 2) {
+        postings.Add(id * 1000, 0.5);
+    }
+    postings.Add(4000, 0.25);
+    ASSERT_EQUAL(postings.size(), 501);
+
+    const PostingListView view = postings.View();
+    int previous = -1;
+    for (const auto [document_id, term_freq] : view) {
+        ASSERT(previous < document_id);
+        previous = document_id;
+    }
+    ASSERT_EQUAL(previous, 1000000);
+
+    ASSERT(view.Contains(4000));
+    ASSERT(is_equal((*view.LowerBound(4000)).term_freq, 0.75));
+    ASSERT(!view.Contains(5000));
+    ASSERT_EQUAL((*view.LowerBound(5001)).document_id, 6000);
+    ASSERT_EQUAL((*view.LowerBound(700000)).document_id, 700000);
+    ASSERT(view.LowerBound(1000001) == view.end());
+
+    // a copy made from a view decodes the same postings
+    const PostingList copy(view);
+    ASSERT_EQUAL(copy.size(), postings.size());
+    ASSERT_EQUAL((*copy.View().LowerBound(5001)).document_id, 6000);
+
+    ASSERT(postings.Remove(700000));
+    ASSERT(!postings.Remove(700000));
+    ASSERT_EQUAL((*postings.View().LowerBound(700000)).document_id, 702000);
+    ASSERT_EQUAL(postings.size(), 500);
+}
+
+void TestMaxResultDocumentCount() {
+    SearchServer server;
+    for (int id = 0; id < 10; ++id) {
+        server.AddDocument(id, "cat"sv, DocumentStatus::ACTUAL, { id });
+    }
+    server.AddDocument(10, "dog"sv, DocumentStatus::ACTUAL, { 1 });
+
+    ASSERT_EQUAL(server.FindTopDocuments("cat"sv).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    server.SetMaxResultDocumentCount(3);
+    for (const std::vector<Document>& fd : { server.FindTopDocuments("cat"sv), server.FindTopDocuments(std::execution::par, "cat"sv) }) {
+        ASSERT_EQUAL(fd.size(), 3);
+        ASSERT_EQUAL(fd[0].id, 9);
+        ASSERT_EQUAL(fd[1].id, 8);
+        ASSERT_EQUAL(fd[2].id, 7);
+    }
+
+    server.SetMaxResultDocumentCount(20);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"sv).size(), 10);
+
+    server.SetMaxResultDocumentCount(0);
+    ASSERT(server.FindTopDocuments("cat"sv).empty());
+}
+
+void TestExternalIdsSurviveReAdding() {
+    SearchServer server;
+    server.AddDocument(9, "cat"sv, DocumentStatus::ACTUAL, { 9 });
+    server.AddDocument(2, "cat"sv, DocumentStatus::BANNED, { 2 });
+    server.AddDocument(5, "cat dog"sv, DocumentStatus::ACTUAL, { 5 });
+
+    server.RemoveDocument(2);
+    server.AddDocument(2, "cat"sv, DocumentStatus::ACTUAL, { 20 });
+
+    const std::vector<int> ids(server.begin(), server.end());
+    ASSERT(ids == std::vector<int>({ 2, 5, 9 }));
+
+    const std::vector<Document> fd = server.FindTopDocuments("cat"sv, [](int document_id, DocumentStatus, int) {
+        return document_id != 9;
+        });
+    ASSERT_EQUAL(fd.size(), 2);
+    ASSERT_EQUAL(fd[0].id, 2);
+    ASSERT_EQUAL(fd[0].rating, 20);
+    ASSERT_EQUAL(fd[1].id, 5);
+
+    ASSERT(std::get<1>(server.MatchDocument("cat"sv, 2)) == DocumentStatus::ACTUAL);
+}
+
+void TestForEachWord() {
+    // reference: split on spaces one character at a time
+    auto split_naive = [](std::string_view text) {
+        std::vector<std::pair<std::string_view, bool>> words;
+        size_t begin = 0;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            if (i == text.size() || text[i] == ' ') {
+                if (i > begin) {
+                    const std::string_view word = text.substr(begin, i - begin);
+                    words.push_back({ word, std::none_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; }) });
+                }
+                begin = i + 1;
+            }
+        }
+        return words;
+    };
+
+    std::mt19937 generator(42);
+    const std::string alphabet = "  ab-\t\x01\xd0\xb0"s;
+    for (int length = 0; length < 200; ++length) {
+        std::string text;
+        for (int i = 0; i < length; ++i) {
+            text.push_back(alphabet[std::uniform_int_distribution<size_t>(0, alphabet.size() - 1)(generator)]);
+        }
+
+        std::vector<std::pair<std::string_view, bool>> words;
+        ForEachWord(text, [&words](std::string_view word, bool is_valid) {
+            words.push_back({ word, is_valid });
+            });
+
+        ASSERT_HINT(words == split_naive(text), text);
+    }
+
+    ASSERT(SplitIntoWords("  funny   pet "sv) == std::vector<std::string_view>({ "funny"sv, "pet"sv }));
+}
+
+void TestAddDocuments() {
+    const std::vector<std::string> texts = {
+        "funny pet and nasty rat"s,
+        "funny pet with curly hair"s,
+        "funny pet and not very nasty rat"s,
+        "pet with rat and rat and rat"s,
+        "nasty rat with curly hair"s,
+    };
+
+    SearchServer expected("and with"sv);
+    std::vector<DocumentInput> batch;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        const int id = static_cast<int>(i) * 3;
+        expected.AddDocument(id, texts[i], DocumentStatus::ACTUAL, { id, 1 });
+        batch.push_back({ id, texts[i], DocumentStatus::ACTUAL, { id, 1 } });
+    }
+
+    SearchServer server("and with"sv);
+    server.AddDocument(1, "curly dog"sv, DocumentStatus::ACTUAL, { 1 });
+    server.RemoveDocument(1);
+    server.AddDocuments(std::execution::par, batch);
+
+    ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+    for (const std::string_view query : { "curly pet"sv, "rat -hair"sv, "nasty funny very"sv }) {
+        const std::vector<Document> lhs = server.FindTopDocuments(query);
+        const std::vector<Document> rhs = expected.FindTopDocuments(query);
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT(is_equal(lhs[i].relevance, rhs[i].relevance));
+            ASSERT_EQUAL(lhs[i].rating, rhs[i].rating);
+        }
+    }
+
+    // a rejected batch leaves the server untouched
+    bool thrown = false;
+    try {
+        server.AddDocuments(std::execution::seq, std::vector<DocumentInput>{ { 100, "cat"sv, DocumentStatus::ACTUAL, {} }, { 100, "dog"sv, DocumentStatus::ACTUAL, {} } });
+    }
+    catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+    ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+    ASSERT(server.FindTopDocuments("cat"sv).empty());
+}
+
+void TestRemoveDocumentsBatch() {
+    SearchServer server = GetTestServerWithDuplicates();
+    server.RemoveDocuments(std::execution::par, std::vector<int>{ 7, 3, 42, 7, 5 });
+
+    const std::vector<int> ids(server.begin(), server.end());
+    ASSERT(ids == std::vector<int>({ 1, 2, 4, 6, 8, 9 }));
+    ASSERT_EQUAL(server.GetDocumentCount(), 6);
+
+    SearchServer single = GetTestServerWithDuplicates();
+    for (const int id : { 7, 3, 5 }) {
+        single.RemoveDocument(std::execution::par, id);
+    }
+
+    for (const std::string_view query : { "funny pet"sv, "rat -curly"sv, "very nasty"sv }) {
+        const std::vector<Document> lhs = server.FindTopDocuments(query);
+        const std::vector<Document> rhs = single.FindTopDocuments(query);
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT(is_equal(lhs[i].relevance, rhs[i].relevance));
+        }
+    }
+    ASSERT(server.FindTopDocuments("very"sv).size() == 1);
+}
+
+void TestMaxScoreMatchesExhaustive() {
+    std::mt19937 generator(7);
+    std::vector<std::string> dictionary;
+    for (int i = 0; i < 60; ++i) {
+        dictionary.push_back("w"s + std::to_string(i));
+    }
+    // skewed word choice, so that upper bounds differ between words
+    auto random_word = [&generator, &dictionary]() {
+        const size_t a = std::uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator);
+        const size_t b = std::uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator);
+        return dictionary[std::min(a, b)];
+    };
+
+    SearchServer server("w0"sv);
+    for (int id = 0; id < 400; ++id) {
+        std::string text;
+        const int length = std::uniform_int_distribution<int>(1, 20)(generator);
+        for (int i = 0; i < length; ++i) {
+            text += random_word() + " "s;
+        }
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % 4), { id });
+    }
+
+    auto predicate = [](int document_id, DocumentStatus status, int) {
+        return status != DocumentStatus::BANNED && document_id % 7 != 0;
+    };
+
+    for (const size_t top_count : { 1, 5, 20 }) {
+        server.SetMaxResultDocumentCount(top_count);
+        for (int q = 0; q < 100; ++q) {
+            std::string query;
+            const int length = std::uniform_int_distribution<int>(1, 10)(generator);
+            for (int i = 0; i < length; ++i) {
+                query += (i % 4 == 3 ? "-"s : ""s) + random_word() + " "s;
+            }
+
+            const std::vector<Document> exhaustive = server.FindTopDocuments(std::execution::seq, query, predicate, QueryEngine::EXHAUSTIVE);
+            const std::vector<Document> pruned = server.FindTopDocuments(std::execution::seq, query, predicate, QueryEngine::MAX_SCORE);
+
+            ASSERT_EQUAL_HINT(exhaustive.size(), pruned.size(), query);
+            for (size_t i = 0; i < exhaustive.size(); ++i) {
+                ASSERT_EQUAL_HINT(exhaustive[i].id, pruned[i].id, query);
+                ASSERT_EQUAL_HINT(exhaustive[i].relevance, pruned[i].relevance, query);
+            }
+        }
+    }
+}
+
+void TestSnapshot() {
+    SearchServer server = GetTestServerWithDuplicates();
+    server.RemoveDocument(3);
+    server.SetMaxResultDocumentCount(3);
+
+    const std::string path = "search_server_test.snapshot"s;
+    server.SaveSnapshot(path);
+    SearchServer loaded = SearchServer::LoadSnapshot(path);
+
+    ASSERT(std::vector<int>(server.begin(), server.end()) == std::vector<int>(loaded.begin(), loaded.end()));
+    ASSERT_EQUAL(loaded.GetMaxResultDocumentCount(), 3);
+    for (const std::string_view query : { "funny pet"sv, "rat -curly"sv, "very nasty and"sv }) {
+        const std::vector<Document> lhs = server.FindTopDocuments(query);
+        const std::vector<Document> rhs = loaded.FindTopDocuments(query);
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT_EQUAL(lhs[i].relevance, rhs[i].relevance);
+            ASSERT_EQUAL(lhs[i].rating, rhs[i].rating);
+        }
+    }
+    ASSERT(std::get<0>(loaded.MatchDocument("curly hair -rat"sv, 4)) == std::get<0>(server.MatchDocument("curly hair -rat"sv, 4)));
+
+    // the loaded server stays writable
+    loaded.AddDocument(3, "curly cat"sv, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(loaded.FindTopDocuments("cat"sv).size(), 1);
+
+    // a damaged file is rejected
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(20);
+        file.put('\x7f');
+    }
+    bool thrown = false;
+    try {
+        SearchServer::LoadSnapshot(path);
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+    std::remove(path.c_str());
+}
+
+void TestMapSnapshot() {
+    SearchServer server = GetTestServerWithDuplicates();
+    server.RemoveDocument(3);
+
+    const std::string path = "search_server_test.snapshot"s;
+    server.SaveSnapshot(path);
+    {
+        const SearchServer mapped = SearchServer::MapSnapshot(path);
+        ASSERT(mapped.IsReadOnly());
+        ASSERT_EQUAL(mapped.GetDocumentCount(), server.GetDocumentCount());
+        ASSERT(std::vector<int>(server.begin(), server.end()) == std::vector<int>(mapped.begin(), mapped.end()));
+        for (const std::string_view query : { "funny pet"sv, "rat -curly"sv, "very nasty and"sv }) {
+            for (const QueryEngine engine : { QueryEngine::EXHAUSTIVE, QueryEngine::MAX_SCORE }) {
+                const std::vector<Document> lhs = server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, engine);
+                const std::vector<Document> rhs = mapped.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, engine);
+                ASSERT_EQUAL(lhs.size(), rhs.size());
+                for (size_t i = 0; i < lhs.size(); ++i) {
+                    ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+                    ASSERT_EQUAL(lhs[i].relevance, rhs[i].relevance);
+                }
+            }
+        }
+        ASSERT(std::get<0>(mapped.MatchDocument("curly hair -rat"sv, 4)) == std::get<0>(server.MatchDocument("curly hair -rat"sv, 4)));
+        ASSERT(mapped.GetWordFrequencies(2) == server.GetWordFrequencies(2));
+
+        // saving a mapped server writes the same index
+        const std::string copy_path = "search_server_test_copy.snapshot"s;
+        mapped.SaveSnapshot(copy_path);
+        const SearchServer reloaded = SearchServer::LoadSnapshot(copy_path);
+        ASSERT(std::vector<int>(reloaded.begin(), reloaded.end()) == std::vector<int>(mapped.begin(), mapped.end()));
+        std::remove(copy_path.c_str());
+
+        SearchServer copy = mapped;
+        bool thrown = false;
+        try {
+            copy.AddDocument(3, "curly cat"sv, DocumentStatus::ACTUAL, { 1 });
+        }
+        catch (const std::logic_error&) {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    }
+
+    // without the checksum a damaged byte is either rejected or leaves every read in bounds
+    const auto check_damaged_snapshots = [&path](const SearchServer& source, const std::vector<std::string_view>& queries) {
+        source.SaveSnapshot(path);
+        std::string contents;
+        {
+            std::ifstream file(path, std::ios::binary);
+            contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        for (size_t offset = 0; offset < contents.size(); ++offset) {
+            for (const char damage : { '\xff', '\x00' }) {
+                std::string damaged = contents;
+                damaged[offset] = damage;
+                {
+                    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+                    file.write(damaged.data(), damaged.size());
+                }
+                try {
+                    const SearchServer mapped = SearchServer::MapSnapshot(path, false);
+                    for (const std::string_view query : queries) {
+                        for (const QueryEngine engine : { QueryEngine::EXHAUSTIVE, QueryEngine::MAX_SCORE, QueryEngine::CONJUNCTIVE }) {
+                            mapped.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, engine);
+                        }
+                    }
+                }
+                catch (const std::runtime_error&) {
+                }
+            }
+        }
+    };
+    check_damaged_snapshots(server, { "funny pet"sv, "rat -curly"sv, "very nasty and"sv });
+
+    // lists of several blocks, whose inner blocks are only reached through their skip entries
+    SearchServer long_lists;
+    for (int id = 0; id < 300; ++id) {
+        long_lists.AddDocument(id, id % 3 == 0 ? "common rare"sv : "common"sv, DocumentStatus::ACTUAL, { id });
+    }
+    check_damaged_snapshots(long_lists, { "common"sv, "common -rare"sv, "rare common"sv });
+    std::remove(path.c_str());
+}
+
+void TestSegmentedIndex() {
+    std::mt19937 generator(11);
+    std::vector<std::string> texts;
+    for (int id = 0; id < 300; ++id) {
+        std::string text;
+        const int length = std::uniform_int_distribution<int>(1, 12)(generator);
+        for (int i = 0; i < length; ++i) {
+            text += "w"s + std::to_string(std::uniform_int_distribution<int>(0, 40)(generator)) + " "s;
+        }
+        texts.push_back(text);
+    }
+
+    SearchServer whole;
+    SearchServer segmented;
+    segmented.SetSegmentDocumentLimit(3);
+    std::vector<DocumentInput> batch;
+    for (int id = 0; id < 300; ++id) {
+        whole.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+        if (id < 200) {
+            segmented.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+        }
+        else {
+            batch.push_back({ id, texts[id], DocumentStatus::ACTUAL, { id } });
+        }
+    }
+    segmented.AddDocuments(std::execution::par, batch);
+    ASSERT(segmented.GetSegmentCount() > 1);
+
+    auto assert_same_results = [&whole, &segmented]() {
+        ASSERT_EQUAL(whole.GetDocumentCount(), segmented.GetDocumentCount());
+        ASSERT(std::vector<int>(whole.begin(), whole.end()) == std::vector<int>(segmented.begin(), segmented.end()));
+        for (const std::string& query : { "w1 w2 w3"s, "w4 -w5"s, "w6 w7 w8 w9 -w10"s, "w40"s }) {
+            for (const QueryEngine engine : { QueryEngine::EXHAUSTIVE, QueryEngine::MAX_SCORE }) {
+                const std::vector<Document> lhs = whole.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, engine);
+                const std::vector<Document> rhs = segmented.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, engine);
+                ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), query);
+                for (size_t i = 0; i < lhs.size(); ++i) {
+                    ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, query);
+                    ASSERT_EQUAL_HINT(lhs[i].relevance, rhs[i].relevance, query);
+                }
+            }
+        }
+        ASSERT(whole.GetWordFrequencies(1) == segmented.GetWordFrequencies(1));
+        ASSERT(std::get<0>(whole.MatchDocument("w1 w2 w3 w4"sv, 299)) == std::get<0>(segmented.MatchDocument("w1 w2 w3 w4"sv, 299)));
+    };
+    assert_same_results();
+
+    // removals hit sealed segments, segments being merged and the open segment
+    std::vector<int> removed;
+    for (int id = 0; id < 300; id += 5) {
+        removed.push_back(id);
+    }
+    whole.RemoveDocuments(removed);
+    segmented.RemoveDocument(removed.back());
+    segmented.RemoveDocuments(std::execution::par, removed);
+    assert_same_results();
+
+    segmented.WaitForMerges();
+    ASSERT(segmented.GetSegmentCount() < 300 / 3 / SEGMENT_MERGE_FACTOR);
+    assert_same_results();
+
+    // churn makes removed slots outnumber live ones, which compacts the slots
+    for (int round = 0; round < 5; ++round) {
+        for (SearchServer* server : { &whole, &segmented }) {
+            for (int id = 101; id < 200; id += 2) {
+                server->RemoveDocument(id);
+            }
+            for (int id = 101; id < 200; id += 2) {
+                server->AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+            }
+        }
+        assert_same_results();
+    }
+    segmented.RemoveDocuments(std::vector<int>{ 101, 103, 298 });
+    whole.RemoveDocuments(std::vector<int>{ 101, 103, 298 });
+    assert_same_results();
+
+    // a snapshot of the segments restores the same index
+    const std::string path = "search_server_test.snapshot"s;
+    segmented.SaveSnapshot(path);
+    {
+        const SearchServer mapped = SearchServer::MapSnapshot(path);
+        ASSERT(std::get<0>(whole.MatchDocument("w1 w2 w3 w4"sv, 299)) == std::get<0>(mapped.MatchDocument("w1 w2 w3 w4"sv, 299)));
+        ASSERT(whole.FindTopDocuments("w4 -w5"sv).size() == mapped.FindTopDocuments("w4 -w5"sv).size());
+    }
+    segmented = SearchServer::LoadSnapshot(path);
+    std::remove(path.c_str());
+    assert_same_results();
+}
+
+void TestConcurrentSearchServer() {
+    SearchServer initial;
+    initial.SetSegmentDocumentLimit(16);
+    ConcurrentSearchServer server(initial);
+
+    // Documents are added and removed in pairs, so a consistent version holds an even number
+    std::atomic<bool> done = false;
+    std::atomic<int> inconsistent = 0;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&server, &done, &inconsistent]() {
+            while (!done) {
+                const bool is_consistent = server.Read([](const SearchServer& version) {
+                    return version.GetDocumentCount() % 2 == 0 && version.FindTopDocuments("pair"sv).size() % 2 == 0;
+                    });
+                if (!is_consistent) {
+                    ++inconsistent;
+                }
+                server.FindTopDocuments(std::execution::seq, "white cat"sv, DocumentStatus::ACTUAL, QueryEngine::MAX_SCORE);
+            }
+            });
+    }
+
+    for (int id = 0; id < 400; id += 2) {
+        server.Write([id](SearchServer& version) {
+            version.SetMaxResultDocumentCount(1000);
+            version.AddDocument(id, "white cat pair"sv, DocumentStatus::ACTUAL, { id });
+            version.AddDocument(id + 1, "black dog pair"sv, DocumentStatus::ACTUAL, { id });
+            });
+        if (id % 10 == 0) {
+            server.RemoveDocuments(std::execution::seq, std::vector<int>{ id, id + 1 });
+        }
+    }
+    done = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    ASSERT_EQUAL(inconsistent, 0);
+    ASSERT_EQUAL(server.GetDocumentCount(), 320);
+    ASSERT_EQUAL(server.FindTopDocuments("white"sv).size(), 160);
+    ASSERT_EQUAL(std::get<0>(server.MatchDocument("white cat"sv, 398)).size(), 2);
+
+    bool thrown = false;
+    try {
+        server.AddDocument(398, "white cat"sv, DocumentStatus::ACTUAL, { 1 });
+    }
+    catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+    ASSERT_EQUAL(server.GetDocumentCount(), 320);
+
+    // the second copy takes over the segments of the first, so both have the same layout
+    const auto get_segment_count = [&server]() {
+        return server.Read([](const SearchServer& version) {
+            return version.GetSegmentCount();
+            });
+    };
+    server.Write([](SearchServer& version) {
+        version.WaitForMerges();
+        });
+    const size_t segment_count = get_segment_count();
+    server.Write([](SearchServer&) {});
+    ASSERT_EQUAL(get_segment_count(), segment_count);
+    ASSERT_EQUAL(server.FindTopDocuments("white"sv).size(), 160);
+}
+
+void TestQueryProcessor() {
+    const SearchServer server = GetTestServerWithDuplicates();
+    std::vector<std::string> queries;
+    for (int i = 0; i < 200; ++i) {
+        queries.push_back(std::vector<std::string>{ "funny pet"s, "curly hair"s, "nasty rat -not"s, "dog"s }[i % 4]);
+    }
+
+    // a small window forces Push to wait for deliveries
+    ThreadPool pool(3);
+    std::vector<std::vector<Document>> streamed;
+    QueryProcessor processor(server, [&streamed](std::vector<Document> documents) {
+        streamed.push_back(std::move(documents));
+        }, 4, pool);
+    size_t pushed = 0;
+    for (const std::string& query : queries) {
+        processor.Push(query);
+        ++pushed;
+        ASSERT(pushed - streamed.size() <= 4);
+    }
+    processor.Finish();
+
+    ASSERT_EQUAL(streamed.size(), queries.size());
+    std::vector<Document> expected_joined;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const std::vector<Document> expected = server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL(streamed[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL(streamed[i][j].id, expected[j].id);
+        }
+        expected_joined.insert(expected_joined.end(), expected.begin(), expected.end());
+    }
+
+    ASSERT_EQUAL(ProcessQueries(server, queries).size(), queries.size());
+    const std::vector<Document> joined = ProcessQueriesJoined(server, queries);
+    ASSERT_EQUAL(joined.size(), expected_joined.size());
+    for (size_t i = 0; i < joined.size(); ++i) {
+        ASSERT_EQUAL(joined[i].id, expected_joined[i].id);
+    }
+}
+
+void TestQueryCache() {
+    SearchServer server = GetTestServerWithDuplicates();
+    const std::vector<Document> uncached = server.FindTopDocuments("curly hair -rat"s);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits + server.GetQueryCacheStats().misses, 0u);
+
+    server.SetQueryCacheCapacity(100);
+    ASSERT_EQUAL(server.FindTopDocuments("curly hair -rat"s).size(), uncached.size());
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 1u);
+
+    // word order, repeats and stop words don't change the key
+    const std::vector<Document> cached = server.FindTopDocuments("hair with curly curly -rat"s);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 1u);
+    ASSERT_EQUAL(cached.size(), uncached.size());
+    for (size_t i = 0; i < cached.size(); ++i) {
+        ASSERT_EQUAL(cached[i].id, uncached[i].id);
+    }
+
+    // other status, other entry
+    ASSERT(server.FindTopDocuments("curly hair -rat"s, DocumentStatus::BANNED).empty());
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 2u);
+
+    // a request queue gets the cached results
+    RequestQueue request_queue(server);
+    request_queue.AddFindRequest("curly hair -rat"s);
+    request_queue.AddFindRequest("curly hair -rat"s, DocumentStatus::BANNED);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 3u);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1);
+
+    // writes invalidate
+    const uint64_t generation = server.GetGeneration();
+    server.AddDocument(10, "curly hair"sv, DocumentStatus::ACTUAL, { 5 });
+    ASSERT(server.GetGeneration() > generation);
+    ASSERT_EQUAL(server.FindTopDocuments("curly hair -rat"s).size(), uncached.size() + 1);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 3u);
+    server.RemoveDocument(10);
+    ASSERT_EQUAL(server.FindTopDocuments("curly hair -rat"s).size(), uncached.size());
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 4u);
+
+    // custom predicates bypass the cache
+    server.FindTopDocuments("curly hair -rat"s, [](int, DocumentStatus, int) { return true; });
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits + server.GetQueryCacheStats().misses, 7u);
+
+    // the least recently used entries are evicted
+    for (int i = 0; i < 1000; ++i) {
+        server.AddDocument(100 + i, "word"s + std::to_string(i), DocumentStatus::ACTUAL, { 1 });
+    }
+    server.SetQueryCacheCapacity(QUERY_CACHE_SHARD_COUNT);
+    for (int i = 0; i < 1000; ++i) {
+        server.FindTopDocuments("word"s + std::to_string(i));
+    }
+    server.FindTopDocuments("word0"s);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 0u);
+}
+
+void TestRequestQueue() {
+    const SearchServer server = GetTestServerWithDuplicates();
+
+    // the oldest requests leave a full log
+    RequestQueue request_queue(server, std::chrono::hours(1), 3);
+    request_queue.AddFindRequest("curly hair"s);
+    request_queue.AddFindRequest("elephant"s);
+    request_queue.AddFindRequest("elephant"s);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 2);
+    request_queue.AddFindRequest("funny pet"s);
+    request_queue.AddFindRequest("rat"s, DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1);
+
+    const RequestQueue::Stats stats = request_queue.GetStats();
+    ASSERT_EQUAL(stats.request_count, 3u);
+    ASSERT_EQUAL(stats.no_result_count, 1u);
+    ASSERT_EQUAL(stats.document_count, server.FindTopDocuments("funny pet"s).size() + server.FindTopDocuments("rat"s).size());
+    ASSERT(stats.latency.count() >= 0);
+
+    // and so do the requests older than the window
+    RequestQueue recent_queue(server, std::chrono::milliseconds(20));
+    recent_queue.AddFindRequest("elephant"s);
+    recent_queue.AddFindRequest("elephant"s);
+    ASSERT_EQUAL(recent_queue.GetNoResultRequests(), 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    ASSERT_EQUAL(recent_queue.GetNoResultRequests(), 0);
+    recent_queue.AddFindRequest("curly hair"s);
+    ASSERT_EQUAL(recent_queue.GetStats().request_count, 1u);
+
+    // concurrent requests, every one is counted once
+    RequestQueue shared_queue(server, std::chrono::hours(1), 100);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&shared_queue, t]() {
+            for (int i = 0; i < 500; ++i) {
+                shared_queue.AddFindRequest(t % 2 == 0 ? "elephant"s : "curly hair"s);
+            }
+            });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const RequestQueue::Stats shared_stats = shared_queue.GetStats();
+    ASSERT_EQUAL(shared_stats.request_count, 100u);
+    const size_t found_count = server.FindTopDocuments("curly hair"s).size();
+    ASSERT_EQUAL(shared_stats.document_count, (100 - shared_stats.no_result_count) * found_count);
+}
+
+void TestFindDuplicates() {
+    const SearchServer server = GetTestServerWithDuplicates();
+    ASSERT_EQUAL(server.GetDocumentFingerprint(2), server.GetDocumentFingerprint(4));
+    ASSERT(server.GetDocumentFingerprint(1) != server.GetDocumentFingerprint(6));
+    const std::vector<int> expected = { 3, 4, 5, 7 };
+    ASSERT(FindDuplicates(server) == expected);
+    ASSERT(FindDuplicates(std::execution::par, server) == expected);
+    // identical sets are near duplicates at any threshold
+    ASSERT(FindNearDuplicates(server, 1.0) == expected);
+
+    // documents 100 + i copy base document i % 10 with one of its eight words replaced
+    SearchServer near_server(""sv);
+    std::mt19937 generator(7);
+    std::vector<std::vector<std::string>> bases;
+    for (int i = 0; i < 10; ++i) {
+        std::vector<std::string> words;
+        for (int j = 0; j < 8; ++j) {
+            words.push_back("w"s + std::to_string(i * 8 + j));
+        }
+        bases.push_back(words);
+    }
+    const auto join = [](const std::vector<std::string>& words) {
+        std::string text;
+        for (const std::string& word : words) {
+            text += word + " "s;
+        }
+        return text;
+    };
+    for (int i = 0; i < 10; ++i) {
+        near_server.AddDocument(i, join(bases[i]), DocumentStatus::ACTUAL, { 1 });
+    }
+    for (int i = 0; i < 200; ++i) {
+        std::vector<std::string> words = bases[i % 10];
+        words[generator() % words.size()] = "x"s + std::to_string(i);
+        near_server.AddDocument(100 + i, join(words), DocumentStatus::ACTUAL, { 1 });
+    }
+
+    // 7 common words of 9: similarity 0.78 with the base, at least 0.6 between copies
+    std::vector<int> copies;
+    for (int i = 0; i < 200; ++i) {
+        copies.push_back(100 + i);
+    }
+    ASSERT(FindNearDuplicates(near_server, 0.75) == copies);
+    ASSERT(FindNearDuplicates(std::execution::par, near_server, 0.5) == copies);
+    ASSERT(FindNearDuplicates(near_server, 0.9).empty());
+    ASSERT(FindDuplicates(near_server).empty());
+
+    RemoveNearDuplicates(near_server, 0.75);
+    ASSERT_EQUAL(near_server.GetDocumentCount(), 10);
+
+    try {
+        FindNearDuplicates(near_server, 0.0);
+        ASSERT_HINT(false, "similarity 0 must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
+void TestConjunctiveQueries() {
+    // kernels over lists spanning many blocks
+    PostingList evens, threes, sevens;
+    for (int i = 0; i < 3000; ++i) {
+        if (i % 2 == 0) evens.Add(i, 1.0);
+        if (i % 3 == 0) threes.Add(i, 2.0);
+        if (i % 7 == 0) sevens.Add(i, 3.0);
+    }
+    std::vector<int> intersection;
+    ForEachIntersection({ evens.View(), threes.View() }, { sevens.View() }, [&intersection](int document_id, const std::vector<double>& term_freqs) {
+        ASSERT_EQUAL(term_freqs[0], 1.0);
+        ASSERT_EQUAL(term_freqs[1], 2.0);
+        intersection.push_back(document_id);
+        });
+    std::vector<int> difference;
+    ForEachPostingExcept(threes.View(), { evens.View(), sevens.View() }, [&difference](const Posting posting) {
+        difference.push_back(posting.document_id);
+        });
+    std::vector<int> expected_intersection, expected_difference;
+    for (int i = 0; i < 3000; ++i) {
+        if (i % 6 == 0 && i % 7 != 0) expected_intersection.push_back(i);
+        if (i % 3 == 0 && i % 2 != 0 && i % 7 != 0) expected_difference.push_back(i);
+    }
+    ASSERT(intersection == expected_intersection);
+    ASSERT(difference == expected_difference);
+
+    // documents of words w0..w7, a few removed, over several segments
+    SearchServer server(""sv);
+    server.SetSegmentDocumentLimit(100);
+    std::mt19937 generator(19);
+    for (int id = 0; id < 1000; ++id) {
+        std::string text;
+        for (int j = 0; j < 5; ++j) {
+            text += "w"s + std::to_string(generator() % 8) + " "s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 10 });
+    }
+    for (int id = 0; id < 1000; id += 9) {
+        server.RemoveDocument(id);
+    }
+    server.SetMaxResultDocumentCount(1000);
+
+    for (const std::string& query : { "w1 w2"s, "w1 w2 w3 -w4"s, "w5 -w0 -w6"s, "w7 nothing"s }) {
+        const std::vector<Document> all = server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL);
+        const auto [plus_words, minus_words] = [&query]() {
+            std::vector<std::string> plus, minus;
+            for (const std::string_view word : SplitIntoWords(query)) {
+                (word[0] == '-' ? minus : plus).push_back(std::string(word[0] == '-' ? word.substr(1) : word));
+            }
+            return std::pair{ plus, minus };
+        }();
+        std::vector<int> expected;
+        for (const Document& document : all) {
+            const std::map<std::string_view, double> words = server.GetWordFrequencies(document.id);
+            if (std::all_of(plus_words.begin(), plus_words.end(), [&words](const std::string& word) { return words.count(word) > 0; })) {
+                expected.push_back(document.id);
+            }
+        }
+        for (const auto& policy_result : { server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, QueryEngine::CONJUNCTIVE),
+            server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, QueryEngine::CONJUNCTIVE) }) {
+            // equally relevant documents may come in any order
+            std::vector<int> ids;
+            for (const Document& document : policy_result) {
+                ids.push_back(document.id);
+            }
+            std::sort(ids.begin(), ids.end());
+            std::sort(expected.begin(), expected.end());
+            ASSERT_HINT(ids == expected, query);
+        }
+        for (const Document& document : all) {
+            for (const std::string& word : minus_words) {
+                ASSERT_HINT(server.GetWordFrequencies(document.id).count(word) == 0, query);
+            }
+        }
+    }
+}
+
+void TestPreparedQuery() {
+    SearchServer server = GetTestServerWithDuplicates();
+    const PreparedQuery query = server.PrepareQuery("curly hair rat -funny elephant"sv);
+    ASSERT_EQUAL(query.GetPlusWords().size(), 3u);
+    ASSERT_EQUAL(query.GetMinusWords().size(), 1u);
+
+    const auto assert_same = [&server, &query](const std::string& raw_query) {
+        const std::vector<Document> expected = server.FindTopDocuments(raw_query);
+        for (const std::vector<Document>& found : { server.FindTopDocuments(query), server.FindTopDocuments(std::execution::par, query),
+            server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, QueryEngine::MAX_SCORE) }) {
+            ASSERT_EQUAL(found.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL(found[i].id, expected[i].id);
+                ASSERT(std::abs(found[i].relevance - expected[i].relevance) < 1e-6);
+            }
+        }
+    };
+    assert_same("curly hair rat -funny"s);
+
+    // inverse document frequencies follow the index
+    server.AddDocument(20, "curly rat"sv, DocumentStatus::ACTUAL, { 3 });
+    server.RemoveDocument(9);
+    assert_same("curly hair rat -funny"s);
+
+    // words that were unknown at preparation don't match
+    server.AddDocument(21, "elephant"sv, DocumentStatus::ACTUAL, { 3 });
+    ASSERT(server.FindTopDocuments(query, [](int document_id, DocumentStatus, int) { return document_id == 21; }).empty());
+
+    const auto [words, status] = server.MatchDocument(query, 20);
+    ASSERT(words == std::vector<std::string_view>({ "curly"sv, "rat"sv }));
+    ASSERT(std::get<0>(server.MatchDocument(query, 1)).empty());
+
+    ConcurrentSearchServer concurrent_server(server);
+    const PreparedQuery concurrent_query = concurrent_server.PrepareQuery("curly"sv);
+    concurrent_server.AddDocument(22, "curly curly"sv, DocumentStatus::ACTUAL, { 9 });
+    ASSERT_EQUAL(concurrent_server.FindTopDocuments(concurrent_query)[0].id, 22);
+}
+
+void TestMetrics() {
+    // every value is counted in a bucket no wider than 1/64 of it
+    for (uint64_t value : { 0ull, 1ull, 127ull, 128ull, 129ull, 1000ull, 123456789ull, 1ull << 41 }) {
+        const uint64_t bucket_max = LatencyHistogram::GetBucketMaxValue(LatencyHistogram::GetBucket(value));
+        ASSERT(bucket_max >= value);
+        ASSERT(bucket_max - value <= value / 64);
+    }
+
+    LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&histogram]() {
+            for (uint64_t value = 1; value <= 1000; ++value) {
+                histogram.Record(value * 1000);
+            }
+            });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const LatencySummary summary = histogram.Summarize();
+    ASSERT_EQUAL(summary.count, 4000u);
+    ASSERT_EQUAL(summary.max, 1'000'000u);
+    ASSERT(std::abs(summary.mean - 500'500) < 1);
+    ASSERT(summary.p50 >= 500'000 && summary.p50 <= 500'000 + 500'000 / 64);
+    ASSERT(summary.p99 >= 990'000 && summary.p99 <= 990'000 + 990'000 / 64);
+    ASSERT(summary.p999 >= 999'000 && summary.p999 <= 1'000'000);
+
+    MetricsRegistry registry;
+    ASSERT_EQUAL(&registry.GetCounter("requests"s), &registry.GetCounter("requests"s));
+    registry.GetCounter("requests"s).Add(3);
+    registry.GetGauge("documents"s).Set(-2);
+    registry.GetHistogram("latency"s).Record(std::chrono::microseconds(5));
+    std::ostringstream text;
+    registry.PrintText(text);
+    ASSERT_EQUAL(text.str(), "requests 3\ndocuments -2\nlatency count=1 mean=5000 p50=5000 p90=5000 p99=5000 p999=5000 max=5000\n"s);
+    std::ostringstream json;
+    registry.PrintJson(json);
+    ASSERT_EQUAL(json.str(), "{\"counters\": {\"requests\": 3}, \"gauges\": {\"documents\": -2}, \"histograms\": {\"latency\": "
+        "{\"count\": 1, \"mean_ns\": 5000, \"p50_ns\": 5000, \"p90_ns\": 5000, \"p99_ns\": 5000, \"p999_ns\": 5000, \"max_ns\": 5000}}}"s);
+
+#ifdef SEARCH_SERVER_METRICS
+    const SearchServerMetrics& metrics = SearchServerMetrics::Get();
+    const uint64_t query_count = metrics.queries.Get();
+    const uint64_t parse_count = metrics.parse.Summarize().count;
+    SearchServer server = GetTestServerWithDuplicates();
+    server.FindTopDocuments("curly hair"sv);
+    ASSERT_EQUAL(metrics.queries.Get(), query_count + 1);
+    ASSERT_EQUAL(metrics.parse.Summarize().count, parse_count + 1);
+#endif
+}
+
+void TestMatchDocuments() {
+    const SearchServer server = GetTestServerWithDuplicates();
+    std::vector<int> document_ids(server.begin(), server.end());
+    std::reverse(document_ids.begin(), document_ids.end());
+
+    for (const std::string& raw_query : { "curly hair rat"s, "curly hair rat -funny"s, "-curly"s, "elephant"s }) {
+        const PreparedQuery query = server.PrepareQuery(raw_query);
+        for (const auto& matches : { server.MatchDocuments(raw_query, document_ids), server.MatchDocuments(std::execution::par, query, document_ids) }) {
+            ASSERT_EQUAL(matches.size(), document_ids.size());
+            for (size_t i = 0; i < document_ids.size(); ++i) {
+                const auto [expected_words, expected_status] = server.MatchDocument(raw_query, document_ids[i]);
+                const auto& [words, status] = matches[i];
+                ASSERT(words == expected_words);
+                ASSERT(status == expected_status);
+            }
+        }
+    }
+
+    const auto [words, status] = server.MatchDocuments("hair curly curly dog -nasty"sv, std::vector<int>{ 3 })[0];
+    ASSERT(words == std::vector<std::string_view>({ "curly"sv, "hair"sv }));
+    ASSERT(std::get<0>(server.MatchDocument(std::execution::par, "curly dog hair"sv, 3)) == words);
+    ASSERT(std::get<0>(server.MatchDocuments("pet -funny"sv, std::vector<int>{ 2 })[0]).empty());
+
+    try {
+        server.MatchDocuments("curly"sv, std::vector<int>{ 1, 100 });
+        ASSERT_HINT(false, "missing document must throw"s);
+    }
+    catch (const std::out_of_range&) {
+    }
+}
+
+void TestScoreAccumulator() {
+    ScoreAccumulator accumulator;
+    const auto collect = [&accumulator]() {
+        std::vector<std::pair<int, double>> scores;
+        accumulator.ForEachScore([&scores](int slot, double score) {
+            scores.push_back({ slot, score });
+            });
+        return scores;
+    };
+
+    // few touched slots are read back through the sorted touched list
+    accumulator.Reset(100, 1000);
+    accumulator.Add(900, 1.5);
+    accumulator.Add(105, 0);
+    accumulator.Add(900, 2);
+    ASSERT_EQUAL(accumulator.GetTouchedCount(), 2u);
+    ASSERT((collect() == std::vector<std::pair<int, double>>{ { 105, 0.0 }, { 900, 3.5 } }));
+
+    // many through a scan of the range, and the scores start from zero again
+    accumulator.Reset(0, 4);
+    for (int slot : { 3, 1, 2, 1 }) {
+        accumulator.Add(slot, 1);
+    }
+    ASSERT((collect() == std::vector<std::pair<int, double>>{ { 1, 2.0 }, { 2, 1.0 }, { 3, 1.0 } }));
+
+    // scores left by an interrupted query are dropped
+    accumulator.Add(0, 7);
+    accumulator.Reset(0, 4);
+    accumulator.Add(1, 1);
+    ASSERT((collect() == std::vector<std::pair<int, double>>{ { 1, 1.0 } }));
+
+    // the predicate and deletions are applied once per document, before the top is taken
+    SearchServer server = GetTestServerWithDuplicates();
+    server.RemoveDocument(2);
+    int predicate_call_count = 0;
+    const auto found = server.FindTopDocuments("curly hair pet"sv, [&predicate_call_count](int document_id, DocumentStatus, int) {
+        ++predicate_call_count;
+        return document_id % 2 == 1;
+        });
+    ASSERT_EQUAL(predicate_call_count, server.GetDocumentCount());
+    for (const Document& document : found) {
+        ASSERT(document.id % 2 == 1);
+    }
+    ASSERT_EQUAL(found[0].id, 3);
+}
+
+void TestRankings() {
+    SearchServer server("and"sv);
+    server.AddDocument(1, "cat and dog"sv, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "cat cat cat mouse"sv, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "mouse"sv, DocumentStatus::ACTUAL, { 3 });
+
+    // BM25 by the textbook: lengths 2, 4 and 1 without the stop word
+    const double k1 = 1.2;
+    const double b = 0.75;
+    const double average_length = 7.0 / 3;
+    const double idf = std::log(1 + (3 - 2 + 0.5) / (2 + 0.5));
+    const auto bm25 = [&](double count, double length) {
+        return idf * count * (k1 + 1) / (count + k1 * (1 - b + b * length / average_length));
+    };
+    const std::vector<Document> found = server.FindTopDocuments(std::execution::seq, "cat"sv, DocumentStatus::ACTUAL, QueryEngine::EXHAUSTIVE, Bm25Ranking(k1, b));
+    ASSERT_EQUAL(found.size(), 2u);
+    ASSERT_EQUAL(found[0].id, 2);
+    ASSERT(std::abs(found[0].relevance - bm25(3, 4)) < 1e-6);
+    ASSERT(std::abs(found[1].relevance - bm25(1, 2)) < 1e-6);
+
+    // TF-IDF given explicitly is the default ranking
+    const std::vector<Document> tf_idf = server.FindTopDocuments(std::execution::seq, "cat mouse"sv, DocumentStatus::ACTUAL, QueryEngine::EXHAUSTIVE, TfIdfRanking());
+    const std::vector<Document> by_default = server.FindTopDocuments("cat mouse"sv);
+    ASSERT_EQUAL(tf_idf.size(), by_default.size());
+    for (size_t i = 0; i < tf_idf.size(); ++i) {
+        ASSERT_EQUAL(tf_idf[i].id, by_default[i].id);
+        ASSERT_EQUAL(tf_idf[i].relevance, by_default[i].relevance);
+    }
+
+    // removed documents leave the average length
+    server.RemoveDocument(3);
+    const double relevance_after_removal = (server.FindTopDocuments(std::execution::seq, "cat"sv, DocumentStatus::ACTUAL, QueryEngine::EXHAUSTIVE, Bm25Ranking(k1, b))[0].relevance);
+    const double idf_after_removal = std::log(1 + (2 - 2 + 0.5) / (2 + 0.5));
+    ASSERT(std::abs(relevance_after_removal - idf_after_removal * 3 * (k1 + 1) / (3 + k1 * (1 - b + b * 4 / 3))) < 1e-6);
+
+    try {
+        Bm25Ranking(1.2, 2);
+        ASSERT_HINT(false, "b above 1 must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    // the engines agree under BM25, so its score bounds are upper bounds
+    std::mt19937 generator(11);
+    SearchServer random_server("w0"sv);
+    for (int id = 0; id < 400; ++id) {
+        std::string text;
+        const int length = std::uniform_int_distribution<int>(1, 30)(generator);
+        for (int i = 0; i < length; ++i) {
+            const int a = std::uniform_int_distribution<int>(0, 39)(generator);
+            const int c = std::uniform_int_distribution<int>(0, 39)(generator);
+            text += "w"s + std::to_string(std::min(a, c)) + " "s;
+        }
+        random_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+    }
+    random_server.SetMaxResultDocumentCount(10);
+    for (int q = 0; q < 50; ++q) {
+        const std::string query = "w"s + std::to_string(q % 40) + " w"s + std::to_string((q * 7) % 40) + " -w"s + std::to_string((q * 13) % 40);
+        const std::vector<Document> exhaustive = random_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, QueryEngine::EXHAUSTIVE, Bm25Ranking());
+        const std::vector<Document> pruned = random_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, QueryEngine::MAX_SCORE, Bm25Ranking());
+        ASSERT_EQUAL_HINT(exhaustive.size(), pruned.size(), query);
+        for (size_t i = 0; i < exhaustive.size(); ++i) {
+            ASSERT_EQUAL_HINT(exhaustive[i].id, pruned[i].id, query);
+            ASSERT_EQUAL_HINT(exhaustive[i].relevance, pruned[i].relevance, query);
+        }
+    }
+
+    // lengths and bounds survive snapshots
+    const std::string path = "search_server_test.snapshot"s;
+    random_server.SaveSnapshot(path);
+    {
+        const SearchServer loaded = SearchServer::LoadSnapshot(path);
+        const SearchServer mapped = SearchServer::MapSnapshot(path);
+        for (const QueryEngine engine : { QueryEngine::EXHAUSTIVE, QueryEngine::MAX_SCORE, QueryEngine::CONJUNCTIVE }) {
+            const std::vector<Document> expected = random_server.FindTopDocuments(std::execution::seq, "w1 w2 w3"sv, DocumentStatus::ACTUAL, engine, Bm25Ranking());
+            for (const SearchServer* copy : { &loaded, &mapped }) {
+                const std::vector<Document> actual = copy->FindTopDocuments(std::execution::seq, "w1 w2 w3"sv, DocumentStatus::ACTUAL, engine, Bm25Ranking());
+                ASSERT_EQUAL(actual.size(), expected.size());
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL(actual[i].id, expected[i].id);
+                    ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+                }
+            }
+        }
+    }
+    std::remove(path.c_str());
+}
+
 // The TestSearchServer function is the entry point for running tests
 void TestSearchServer() {
 
@@ -382,4 +1491,28 @@ void TestSearchServer() {
     RUN_TEST(TestRemoveDuplicates);
 
     RUN_TEST(TestMultiThread1);
+    RUN_TEST(TestParallelFindTopDocuments);
+    RUN_TEST(TestInverseDocumentFreqFollowsIndex);
+    RUN_TEST(TestMatchDocumentReturnsDictionaryWords);
+    RUN_TEST(TestPostingList);
+    RUN_TEST(TestMaxResultDocumentCount);
+    RUN_TEST(TestExternalIdsSurviveReAdding);
+    RUN_TEST(TestForEachWord);
+    RUN_TEST(TestAddDocuments);
+    RUN_TEST(TestRemoveDocumentsBatch);
+    RUN_TEST(TestMaxScoreMatchesExhaustive);
+    RUN_TEST(TestSnapshot);
+    RUN_TEST(TestMapSnapshot);
+    RUN_TEST(TestSegmentedIndex);
+    RUN_TEST(TestConcurrentSearchServer);
+    RUN_TEST(TestQueryProcessor);
+    RUN_TEST(TestQueryCache);
+    RUN_TEST(TestRequestQueue);
+    RUN_TEST(TestFindDuplicates);
+    RUN_TEST(TestConjunctiveQueries);
+    RUN_TEST(TestPreparedQuery);
+    RUN_TEST(TestMetrics);
+    RUN_TEST(TestMatchDocuments);
+    RUN_TEST(TestScoreAccumulator);
+    RUN_TEST(TestRankings);
 }
\ No newline at end of file
@@ -1,8 +1,14 @@
 #pragma once
 #include <iomanip>
 #include <random>
+#include <sstream>
+#include <thread>
 
+#include "concurrent_search_server.h"
+#include "metrics.h"
 #include "process_queries.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
 
 template <typename Func>
 void RunTestImpl(Func, const std::string&);
@@ -72,4 +78,39 @@ void TestRemoveDuplicates();
 // The TestSearchServer function is the entry point for running tests
 void TestSearchServer();
 
-void TestMultiThread1();
\ No newline at end of file
+void TestMultiThread1();
+
+void TestParallelFindTopDocuments();
+
+void TestInverseDocumentFreqFollowsIndex();
+
+void TestMatchDocumentReturnsDictionaryWords();
+
+void TestPostingList();
+
+void TestMaxResultDocumentCount();
+
+void TestExternalIdsSurviveReAdding();
+
+void TestForEachWord();
+
+void TestAddDocuments();
+
+void TestRemoveDocumentsBatch();
+
+void TestMaxScoreMatchesExhaustive();
+
+void TestSnapshot();
+void TestMapSnapshot();
+void TestSegmentedIndex();
+void TestConcurrentSearchServer();
+void TestQueryProcessor();
+void TestQueryCache();
+void TestRequestQueue();
+void TestFindDuplicates();
+void TestConjunctiveQueries();
+void TestPreparedQuery();
+void TestMetrics();
+void TestMatchDocuments();
+void TestScoreAccumulator();
+void TestRankings();
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+
+// Pool and queue of the current thread if it is a worker
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    thread_count = std::max<size_t>(thread_count, 1);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this, i]() {
+            Run(i);
+            });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard guard(wake_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    const size_t queue = current_pool == this
+        ? current_worker
+        : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    // Counted before it becomes visible, so a thief taking it at once can't wrap the count
+    {
+        std::lock_guard guard(wake_mutex_);
+        ++queued_count_;
+    }
+    {
+        std::lock_guard guard(queues_[queue]->mutex);
+        queues_[queue]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+ThreadPool& ThreadPool::GetDefault() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::Run(size_t worker) {
+    current_pool = this;
+    current_worker = worker;
+
+    std::function<void()> task;
+    while (true) {
+        if (TryTake(worker, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock lock(wake_mutex_);
+        wake_.wait(lock, [this]() {
+            return stop_ || queued_count_ > 0;
+            });
+        if (stop_ && queued_count_ == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::TryTake(size_t worker, std::function<void()>& task) {
+    for (size_t i = 0; i < queues_.size(); ++i) {
+        WorkerQueue& queue = *queues_[(worker + i) % queues_.size()];
+        std::lock_guard guard(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        // The owner takes tasks in submission order, thieves take from the other end
+        // so they rarely compete with it for the same task
+        if (i == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        --queued_count_;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads with a task queue per worker.
+// A worker takes the oldest task of its own queue and, when that is empty, steals the
+// newest task of another queue, so uneven tasks spread over the pool without a shared queue.
+// Tasks still queued when the pool is destroyed are run before the threads exit.
+class ThreadPool {
+public:
+    // At least one thread is started
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Tasks submitted from a worker go to its own queue, others are spread round-robin
+    void Submit(std::function<void()> task);
+
+    inline size_t GetThreadCount() const noexcept {
+        return threads_.size();
+    }
+
+    // Pool shared by the whole process, one thread per core
+    static ThreadPool& GetDefault();
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    // Tasks submitted and not yet taken, increased under wake_mutex_ before the push
+    std::atomic<size_t> queued_count_ = 0;
+    std::atomic<size_t> next_queue_ = 0;
+    bool stop_ = false;
+
+    void Run(size_t worker);
+
+    bool TryTake(size_t worker, std::function<void()>& task);
+};
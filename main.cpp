@@ -1,6 +1,7 @@
+#include "corpus_generator.h"
 #include "search_server.h"
 #include "test_example_functions.h"
-#include "log_duration.h"
+#include "metrics.h"
 
 #include <execution>
 #include <iostream>
@@ -10,54 +11,12 @@
 
 using namespace std;
 
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(static_cast<char>(uniform_int_distribution(static_cast<int>('a'), static_cast<int>('z'))(generator)));
-    }
-    return word;
-}
-
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
-    }
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
-}
-
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
-        }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
-        }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
-    }
-    return query;
-}
-
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-    vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
-    }
-    return queries;
-}
-
 template <typename ExecutionPolicy>
 void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
+    LatencyHistogram& latency = MetricsRegistry::GetDefault().GetHistogram("main."s + string(mark));
     double total_relevance = 0;
     for (const string_view query : queries) {
+        ScopedTimer timer(latency);
         for (const auto& document : search_server.FindTopDocuments(policy, query)) {
             total_relevance += document.relevance;
         }
@@ -86,4 +45,7 @@ int main() {
 
     TEST(seq);
     TEST(par);
+
+    // Query latencies, and the search stages when built with -DSEARCH_SERVER_METRICS
+    MetricsRegistry::GetDefault().PrintText(cerr);
 }
\ No newline at end of file